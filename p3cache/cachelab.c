@@ -6,10 +6,14 @@
 #include <assert.h>
 #include "cachelab.h"
 #include <time.h>
+#include <string.h>
 
 trans_func_t func_list[MAX_TRANS_FUNCS];
 int func_counter = 0;
 
+trans_gfunc_t gfunc_list[MAX_TRANS_GFUNCS];
+int gfunc_counter = 0;
+
 /*
  * printSummary - Summarize the cache simulation statistics. Student cache simulators
  *                must call this function in order to be properly autograded.
@@ -23,6 +27,19 @@ void printSummary(int hits, int misses, int evictions)
     fclose(output_fp);
 }
 
+/*
+ * printSummaryLong - printSummary for simulators with 64-bit counters
+ */
+void printSummaryLong(unsigned long long hits, unsigned long long misses,
+                      unsigned long long evictions)
+{
+    printf("hits:%llu misses:%llu evictions:%llu\n", hits, misses, evictions);
+    FILE* output_fp = fopen(".csim_results", "w");
+    assert(output_fp);
+    fprintf(output_fp, "%llu %llu %llu\n", hits, misses, evictions);
+    fclose(output_fp);
+}
+
 /*
  * initMatrix - Initialize the given matrix
  */
@@ -64,6 +81,21 @@ void correctTrans(int M, int N, int A[N][M], int B[M][N])
     }
 }
 
+/*
+ * correctTransGeneric - correctTrans for elements of any size
+ */
+void correctTransGeneric(int M, int N, size_t size, const void *A, void *B)
+{
+    const char *a = (const char*)A;
+    char *b = (char*)B;
+    int i, j;
+    for (i = 0; i < N; i++){
+        for (j = 0; j < M; j++){
+            memcpy(b + ((size_t)j * N + i) * size, a + ((size_t)i * M + j) * size, size);
+        }
+    }
+}
+
 
 
 /*
@@ -81,3 +113,21 @@ void registerTransFunction(void (*trans)(int M, int N, int[N][M], int[M][N]),
     func_list[func_counter].num_evictions =0;
     func_counter++;
 }
+
+/*
+ * registerTransGeneric - Add the given trans function, for elements of
+ *     size bytes, into the list of functions of other types
+ */
+void registerTransGeneric(void (*trans)(int M, int N, void *A, void *B),
+                          size_t size, char* desc)
+{
+    assert(gfunc_counter < MAX_TRANS_GFUNCS);
+    gfunc_list[gfunc_counter].func_ptr = trans;
+    gfunc_list[gfunc_counter].size = size;
+    gfunc_list[gfunc_counter].description = desc;
+    gfunc_list[gfunc_counter].correct = 0;
+    gfunc_list[gfunc_counter].num_hits = 0;
+    gfunc_list[gfunc_counter].num_misses = 0;
+    gfunc_list[gfunc_counter].num_evictions = 0;
+    gfunc_counter++;
+}
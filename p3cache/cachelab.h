@@ -5,7 +5,10 @@
 #ifndef CACHELAB_TOOLS_H
 #define CACHELAB_TOOLS_H
 
+#include <stddef.h>
+
 #define MAX_TRANS_FUNCS 100
+#define MAX_TRANS_GFUNCS 32
 
 typedef struct trans_func{
   void (*func_ptr)(int M,int N,int[N][M],int[M][N]);
@@ -16,6 +19,17 @@ typedef struct trans_func{
   unsigned int num_evictions;
 } trans_func_t;
 
+/* A transpose of elements other than int; A is N x M elements of size bytes */
+typedef struct trans_gfunc{
+  void (*func_ptr)(int M,int N,void *A,void *B);
+  size_t size;
+  char* description;
+  char correct;
+  unsigned int num_hits;
+  unsigned int num_misses;
+  unsigned int num_evictions;
+} trans_gfunc_t;
+
 /*
  * printSummary - This function provides a standard way for your cache
  * simulator * to display its final hit and miss statistics
@@ -24,14 +38,31 @@ void printSummary(int hits,  /* number of  hits */
 				  int misses, /* number of misses */
 				  int evictions); /* number of evictions */
 
+/*
+ * printSummaryLong - printSummary for 64-bit counters. The output and
+ * the .csim_results file have the same format, so existing readers
+ * keep working as long as the counts fit their types.
+ */
+void printSummaryLong(unsigned long long hits,
+                      unsigned long long misses,
+                      unsigned long long evictions);
+
 /* Fill the matrix with data */
 void initMatrix(int M, int N, int A[N][M], int B[M][N]);
 
 /* The baseline trans function that produces correct results. */
 void correctTrans(int M, int N, int A[N][M], int B[M][N]);
 
+/* correctTrans for elements of size bytes */
+void correctTransGeneric(int M, int N, size_t size, const void *A, void *B);
+
 /* Add the given function to the function list */
 void registerTransFunction(
     void (*trans)(int M,int N,int[N][M],int[M][N]), char* desc);
 
+/* Add the given function to the list of functions of other types; tools
+   number them after the int functions */
+void registerTransGeneric(
+    void (*trans)(int M,int N,void *A,void *B), size_t size, char* desc);
+
 #endif /* CACHELAB_TOOLS_H */
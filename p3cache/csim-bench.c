@@ -0,0 +1,357 @@
+/*
+ * csim-bench.c - Measures the throughput of the cache simulator itself.
+ *
+ * Runs ./csim over a matrix of cache geometries (E x s) and trace
+ * shapes, timing every run and recording the peak resident set size of
+ * the child. Results are written as CSV so that runs can be diffed or
+ * compared against a saved baseline with -c, which makes a slowdown in
+ * the simulator's hot loop fail loudly.
+ *
+ * The default run is short enough to run routinely: the small corner of
+ * the matrix and 1M-access streams. -F sweeps the whole matrix, up to
+ * 2^20 sets and 64 ways, over 100M-access streams (several GB of trace).
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+/* The geometry matrix swept by -F; the default run stops at QUICK_E ways
+   and QUICK_S set bits */
+static const int bench_E[] = {1, 2, 8, 64};
+static const int bench_s[] = {0, 5, 12, 20};
+#define NUM_E (sizeof(bench_E) / sizeof(bench_E[0]))
+#define NUM_S (sizeof(bench_s) / sizeof(bench_s[0]))
+#define QUICK_E 8
+#define QUICK_S 12
+
+/* Accesses in each generated stream, without and with -F */
+#define QUICK_STREAM 1000000ULL
+#define FULL_STREAM 100000000ULL
+
+/* The recorded traces shipped with the lab */
+static const char *bench_traces[] = {
+    "traces/yi2.trace",
+    "traces/yi.trace",
+    "traces/dave.trace",
+    "traces/trans.trace",
+    "traces/long.trace",
+};
+#define NUM_TRACES (sizeof(bench_traces) / sizeof(bench_traces[0]))
+
+/* Maximum number of rows a baseline file may hold */
+#define MAX_BASELINE 1024
+
+struct bench_row {
+    char trace[256];
+    int s, E, b;
+    unsigned long long accesses;
+    double ns_per_access;
+};
+
+/* Globals set on the command line */
+static unsigned long long stream_len = QUICK_STREAM;
+static int stream_set = 0;
+static int full = 0;
+static int block_bits = 5;
+static int reps = 3;
+static double tolerance = 10.0;
+static char *csim_path = "./csim";
+static int lazy = 0;
+
+static struct bench_row baseline[MAX_BASELINE];
+static int baseline_count = 0;
+static int regressions = 0;
+
+/*
+ * count_accesses - Count the data accesses in a lackey trace; an M
+ *     record is a load and a store, so it counts twice
+ */
+unsigned long long count_accesses(const char *trace)
+{
+    char line[256];
+    unsigned long long n = 0;
+    FILE *fp = fopen(trace, "r");
+    if (fp == NULL)
+        return 0;
+    while (fgets(line, sizeof(line), fp) != NULL)
+        if (line[0] == ' ' && (line[1] == 'L' || line[1] == 'S'))
+            n++;
+        else if (line[0] == ' ' && line[1] == 'M')
+            n += 2;
+    fclose(fp);
+    return n;
+}
+
+/*
+ * gen_stream - Write a synthetic lackey trace of n accesses with synthgen
+ *     (one store in four) over a 64MB footprint
+ */
+int gen_stream(const char *path, const char *model, unsigned long long n)
+{
+    char cmd[512];
+    sprintf(cmd, "./synthgen -m %s -n %llu -f 64M -e 4 -w 0.25 -o %s", model, n, path);
+    return system(cmd) == 0 ? 0 : -1;
+}
+
+/*
+ * run_csim - Run the simulator once, returning the elapsed seconds and
+ *     storing the child's peak RSS (in KB) in *rss_kb. Returns a negative
+ *     value if the simulator could not be run or exited abnormally.
+ */
+double run_csim(const char *trace, int s, int E, int b, long *rss_kb)
+{
+    char sbuf[16], Ebuf[16], bbuf[16];
+    struct timespec start, end;
+    struct rusage ru;
+    int status;
+    pid_t pid;
+
+    sprintf(sbuf, "%d", s);
+    sprintf(Ebuf, "%d", E);
+    sprintf(bbuf, "%d", b);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pid = fork();
+    if (pid < 0)
+        return -1;
+    if (pid == 0) {
+        int devnull = open("/dev/null", O_WRONLY);
+        if (devnull >= 0)
+            dup2(devnull, STDOUT_FILENO);
+        /* Memoized results would time the cache lookup, not the simulator;
+           the environment works for any -x simulator, unlike csim's -N */
+        setenv("CSIM_NOCACHE", "1", 1);
+        if (lazy)
+            execl(csim_path, csim_path, "-L", "-s", sbuf, "-E", Ebuf, "-b", bbuf,
+                  "-t", trace, (char *)NULL);
+        else
+            execl(csim_path, csim_path, "-s", sbuf, "-E", Ebuf, "-b", bbuf,
+                  "-t", trace, (char *)NULL);
+        _exit(127);
+    }
+    if (wait4(pid, &status, 0, &ru) < 0)
+        return -1;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return -1;
+    *rss_kb = ru.ru_maxrss;
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/*
+ * load_baseline - Read a CSV file previously written by csim-bench
+ */
+int load_baseline(const char *path)
+{
+    char line[512];
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return -1;
+    while (fgets(line, sizeof(line), fp) != NULL && baseline_count < MAX_BASELINE) {
+        struct bench_row *r = &baseline[baseline_count];
+        char *comma = strchr(line, ',');
+        if (comma == NULL || comma - line >= (int)sizeof(r->trace))
+            continue;
+        memcpy(r->trace, line, comma - line);
+        r->trace[comma - line] = '\0';
+        if (sscanf(comma + 1, "%d,%d,%d,%llu,%*f,%*f,%lf",
+                   &r->s, &r->E, &r->b, &r->accesses, &r->ns_per_access) == 5)
+            baseline_count++;
+    }
+    fclose(fp);
+    return 0;
+}
+
+/*
+ * check_baseline - Flag a run that is slower than its baseline entry by
+ *     more than the configured tolerance
+ */
+void check_baseline(const char *trace, int s, int E, int b, double ns)
+{
+    int i;
+    for (i = 0; i < baseline_count; i++) {
+        struct bench_row *r = &baseline[i];
+        if (strcmp(r->trace, trace) == 0 && r->s == s && r->E == E && r->b == b) {
+            if (ns > r->ns_per_access * (1.0 + tolerance / 100.0)) {
+                fprintf(stderr, "REGRESSION %s (s=%d,E=%d,b=%d): %.2f ns/access, baseline %.2f\n",
+                        trace, s, E, b, ns, r->ns_per_access);
+                regressions++;
+            }
+            return;
+        }
+    }
+}
+
+/*
+ * bench_trace - Sweep the geometry matrix over one trace; rows are
+ *     reported and compared with the baseline under name
+ */
+void bench_trace(FILE *out, const char *trace, const char *name)
+{
+    unsigned int i, j;
+    int k;
+    unsigned long long accesses = count_accesses(trace);
+
+    for (i = 0; i < NUM_E; i++) {
+        for (j = 0; j < NUM_S; j++) {
+            int E = bench_E[i], s = bench_s[j];
+            double best = -1, secs;
+            long rss = 0, peak = 0;
+
+            if (!full && (E > QUICK_E || s > QUICK_S))
+                continue;
+
+            /* Keep the fastest of several runs to reject scheduling noise */
+            for (k = 0; k < reps; k++) {
+                secs = run_csim(trace, s, E, block_bits, &rss);
+                if (secs < 0) {
+                    fprintf(stderr, "Error running %s on %s (s=%d,E=%d,b=%d)\n",
+                            csim_path, trace, s, E, block_bits);
+                    best = -1;
+                    break;
+                }
+                if (best < 0 || secs < best)
+                    best = secs;
+                if (rss > peak)
+                    peak = rss;
+            }
+            if (best < 0)
+                continue;
+
+            double ns = accesses ? best * 1e9 / accesses : 0;
+            fprintf(out, "%s,%d,%d,%d,%llu,%.6f,%.0f,%.3f,%ld\n",
+                    name, s, E, block_bits, accesses, best,
+                    best > 0 ? accesses / best : 0, ns, peak);
+            fflush(out);
+            check_baseline(name, s, E, block_bits, ns);
+        }
+    }
+}
+
+/*
+ * usage - Print usage info
+ */
+void usage(char *argv[])
+{
+    printf("Usage: %s [-hLF] [-n <num>] [-b <num>] [-r <num>] [-o <file>] [-c <file> [-T <pct>]]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h          Print this help message.\n");
+    printf("  -F          Full run: every geometry, and %lluM-access streams.\n", FULL_STREAM / 1000000);
+    printf("  -n <num>    Accesses in each generated stream (default %lluM, 0 to skip).\n",
+           QUICK_STREAM / 1000000);
+    printf("  -b <num>    Block offset bits used for every run (default %d).\n", block_bits);
+    printf("  -r <num>    Repetitions per configuration; the fastest is kept (default %d).\n", reps);
+    printf("  -o <file>   Write CSV results to <file> instead of stdout.\n");
+    printf("  -c <file>   Compare against a baseline CSV and fail on regressions.\n");
+    printf("  -T <pct>    Allowed slowdown against the baseline (default %.0f%%).\n", tolerance);
+    printf("  -L          Run the simulator in lazy set allocation mode.\n");
+    printf("  -x <path>   Simulator to benchmark (default %s).\n", csim_path);
+    printf("Example: %s -F -o bench.csv\n", argv[0]);
+}
+
+int main(int argc, char *argv[])
+{
+    int c;
+    unsigned int i;
+    char *outname = NULL;
+    FILE *out = stdout;
+    char dir[128], seqname[160], randname[160];
+
+    while ((c = getopt(argc, argv, "hLFn:b:r:o:c:T:x:")) != -1) {
+        switch (c) {
+        case 'n':
+            stream_len = strtoull(optarg, NULL, 10);
+            stream_set = 1;
+            break;
+        case 'F':
+            full = 1;
+            break;
+        case 'b':
+            block_bits = atoi(optarg);
+            break;
+        case 'r':
+            reps = atoi(optarg) > 0 ? atoi(optarg) : 1;
+            break;
+        case 'o':
+            outname = optarg;
+            break;
+        case 'c':
+            if (load_baseline(optarg) < 0) {
+                fprintf(stderr, "Error: could not read baseline %s\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'T':
+            tolerance = atof(optarg);
+            break;
+        case 'x':
+            csim_path = optarg;
+            break;
+        case 'L':
+            lazy = 1;
+            break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+
+    if (full && !stream_set)
+        stream_len = FULL_STREAM;
+
+    if (outname != NULL && (out = fopen(outname, "w")) == NULL) {
+        fprintf(stderr, "Error: could not open %s\n", outname);
+        exit(1);
+    }
+
+    fprintf(out, "trace,s,E,b,accesses,seconds,accesses_per_sec,ns_per_access,peak_rss_kb\n");
+    for (i = 0; i < NUM_TRACES; i++)
+        bench_trace(out, bench_traces[i], bench_traces[i]);
+
+    /* Large generated streams exercise the steady-state hot loop */
+    if (stream_len > 0) {
+        /* A private directory, so concurrent runs do not share traces */
+        sprintf(dir, "/tmp/csim-bench-%u-XXXXXX", (unsigned int)getuid());
+        if (mkdtemp(dir) == NULL) {
+            fprintf(stderr, "Error: could not create %s\n", dir);
+            exit(1);
+        }
+        sprintf(seqname, "%s/seq.trace", dir);
+        sprintf(randname, "%s/rand.trace", dir);
+        if (gen_stream(seqname, "seq", stream_len) < 0 ||
+            gen_stream(randname, "uniform", stream_len) < 0) {
+            fprintf(stderr, "Error: could not generate streams in %s\n", dir);
+            unlink(seqname);
+            unlink(randname);
+            rmdir(dir);
+            exit(1);
+        }
+        bench_trace(out, seqname, "synthgen:seq");
+        bench_trace(out, randname, "synthgen:uniform");
+        unlink(seqname);
+        unlink(randname);
+        rmdir(dir);
+    }
+
+    if (out != stdout)
+        fclose(out);
+    if (regressions) {
+        fprintf(stderr, "%d configuration(s) regressed by more than %.0f%%\n",
+                regressions, tolerance);
+        return 1;
+    }
+    return 0;
+}
@@ -1,4 +1,7 @@
+#define _GNU_SOURCE
 #include "cachelab.h"
+#include "trace.h"
+#include "lineset.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
@@ -6,28 +9,213 @@
 #include <limits.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 
-// The block struct starts with an invalid tag (0) and LRU = 0, which is incremented
+// The block struct starts with LRU = 0, which marks it invalid; a filled block
+// always carries a nonzero LRU stamp, so no separate valid bit is stored.
+// Tags are full 64-bit (address >> (s + b)). In shared mode the owning trace
+// is packed above OWNER_SHIFT, which needs s + b >= 64 - OWNER_SHIFT so that
+// no tag reaches it.
 typedef struct block_s
 {
-	int valid;
 	unsigned long long int tag;
-	int LRU;
+	unsigned long long int LRU;
 } block_s;
 
-typedef struct set_s
+#define OWNER_SHIFT 58
+
+// Hit/miss/eviction counts for one stream of accesses
+typedef struct stats_s
 {
-	block_s *blocks;
-} set_s;
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long evicts;
+} stats_s;
 
+// All S*E blocks live in one array; set i owns blocks[i*E] to blocks[i*E+E-1]
+// access is the lookup kernel picked for this geometry (see pick_kernel)
 typedef struct cache_s
 {
 	int s;
 	int E;
 	int b;
-	set_s *sets;
+	int lazy;
+	unsigned long long LRU;
+	int tag_shift;
+	unsigned long long set_mask;
+	size_t bytes;
+	block_s *blocks;
+	int (*access)(struct cache_s *cache, unsigned long long address, stats_s *stats);
 } cache_s;
 
+typedef int (*access_fn)(cache_s *cache, unsigned long long address, stats_s *stats);
+access_fn pick_kernel(int E);
+
+// Largest cache (2^MAX_BLOCK_BITS blocks, 1GB) and DRAM model csim will
+// build; anything bigger is refused as a bad option, so that a query cannot
+// exhaust the server's memory
+#define MAX_BLOCK_BITS 26
+#define MAX_TIMING 65536
+#define MAX_REGIONS 16
+#define MAX_TRACES 8
+// Connections the server holds while every worker is busy
+#define SERVER_QUEUE 64
+#define MAX_ARGS 64
+// Results of earlier runs, named by a digest of the trace, of the options and
+// of the csim binary (see memo_key). Only used with -C or CSIM_CACHE.
+#define MEMO_DIR ".csim_cache"
+// Most offsets (and paddings) the advisor tries per region
+#define ADVISE_STEPS 64
+#define REGION_SHIFT 52
+#define NIL UINT_MAX
+
+// A user-declared address range [lo, hi) with its own statistics
+typedef struct region_s
+{
+	unsigned long long lo;
+	unsigned long long hi;
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long compulsory;
+	unsigned long long capacity;
+	unsigned long long conflict;
+} region_s;
+
+// Shadow structures for 3C classification, updated in the same pass as the cache:
+// an infinite cache (every line ever seen) and a fully associative LRU cache
+// holding as many lines as the real one
+typedef struct shadow_s
+{
+	lineset_t seen;
+	lineset_t where;
+	unsigned long long *line;
+	unsigned int *prev;
+	unsigned int *next;
+	unsigned int head;
+	unsigned int tail;
+	unsigned int used;
+	unsigned int alloc;
+	unsigned int cap;
+	int b;
+	unsigned long long compulsory;
+	unsigned long long capacity;
+	unsigned long long conflict;
+	int nregions;
+	region_s regions[MAX_REGIONS];
+} shadow_s;
+
+// Latency model layered on the hit/miss results: per-level hit latencies,
+// a bounded number of outstanding misses (MSHRs) and a DRAM with one open
+// row per bank. All times are in core cycles.
+typedef struct timing_s
+{
+	int l1;
+	int l2;
+	int mshrs;
+	int banks;
+	int col_bits;
+	int row_hit;
+	int row_miss;
+	int row_conflict;
+	long long *open_row;
+	unsigned long long *mshr_done;
+	unsigned long long now;
+	unsigned long long latency;
+	unsigned long long accesses;
+	unsigned long long row_hits;
+	unsigned long long row_misses;
+	unsigned long long row_conflicts;
+} timing_s;
+
+// Simulation points picked by simpoint (-P): the trace is cut into intervals of
+// length instructions (or records) and each chosen interval stands for a
+// weighted share of all count intervals. start holds the data, instruction
+// and L2 statistics as the measured interval began; est sums the weighted
+// statistics of the intervals measured so far.
+typedef struct sample_s
+{
+	unsigned long long length;
+	unsigned long long count;
+	int records;
+	int npoints;
+	unsigned long long *index;
+	double *weight;
+	// Progress through the trace
+	int next;
+	int measuring;
+	stats_s start[3];
+	double est[3][3];
+} sample_s;
+
+// Everything read from the command line
+typedef struct opts_s
+{
+	int s;
+	int E;
+	int b;
+	char *trace;
+	int h;
+	int v;
+	int L;
+	int classify;
+	int nregions;
+	region_s regions[MAX_REGIONS];
+	int icache;
+	int is;
+	int iE;
+	int ib;
+	int unified;
+	int l2;
+	int s2;
+	int E2;
+	int b2;
+	int timed;
+	timing_s timing;
+	int ntraces;
+	char *traces[MAX_TRACES];
+	int quantum;
+	int nways;
+	int ways[MAX_TRACES];
+	int interval;
+	char *points;
+	char *server;
+	int workers;
+	int memo;
+	int nomemo;
+	int advise;
+	unsigned long long row;
+} opts_s;
+
+// Per-trace accounting when several traces share one cache
+typedef struct tenant_s
+{
+	trace_file_t *tf;
+	stats_s stats;
+	unsigned long long interference;
+	unsigned long long occupancy;
+	int way_lo;
+	int way_hi;
+	lineset_t stolen;
+} tenant_s;
+
+// One simulation: the caches in use, the optional analyses and the results
+typedef struct sim_s
+{
+	cache_s *cache;
+	cache_s *icache;
+	cache_s *l2;
+	shadow_s *shadow;
+	timing_s *timing;
+	stats_s data;
+	stats_s inst;
+	stats_s l2stats;
+} sim_s;
+
 int helpmsg()
 // Basic info printed when -h flag is present
 {
@@ -38,81 +226,455 @@ int helpmsg()
 	printf("-s <num>	Number of set index bits.\n");
 	printf("-E <num>	Number of lines per set.\n");
 	printf("-b <num>	Number of block offset bits.\n");
-	printf("-t <file>	Trace file.\n\n");
+	printf("-t <file>	Trace file.\n");
+	printf("-L		Lazy mode: sets are only initialized when first touched.\n");
+	printf("-c		Classify misses as compulsory, capacity or conflict.\n");
+	printf("-r <lo:hi>	Report -c statistics for addresses in [lo, hi) (repeatable).\n");
+	printf("-i <s,E,b>	Simulate instruction fetches in a separate L1I cache.\n");
+	printf("-u		Simulate instruction fetches in the data cache (unified).\n");
+	printf("-2 <s,E,b>	Add an L2 cache behind the data cache.\n");
+	printf("-T <k=v,...>	Estimate cycles and AMAT of data accesses. Keys (defaults):\n");
+	printf("		l1 (4), l2 (12) hit latencies; mshr (8) outstanding misses;\n");
+	printf("		banks (8), col (13) DRAM banks and log2 row size in bytes;\n");
+	printf("		hit (40), miss (80), conflict (120) DRAM row-buffer latencies.\n");
+	printf("-m <file>	Co-schedule another trace on the same cache (repeatable).\n");
+	printf("-q <num>	Records each trace runs before switching (default 1).\n");
+	printf("-W <w0,w1,..>	Partition the ways among the traces, in -t/-m order.\n");
+	printf("-o <num>	Print per-trace occupancy every <num> accesses.\n");
+	printf("-P <file>	Simulate only the intervals chosen by simpoint and extrapolate.\n");
+	printf("-S <socket>	Serve queries from csim-client on a Unix socket; no -t needed.\n");
+	printf("-j <num>	Server worker threads (default: one per CPU).\n");
+	printf("-C		Reuse results of earlier identical runs from " MEMO_DIR ", and store\n");
+	printf("		new ones there. Setting CSIM_CACHE does the same.\n");
+	printf("-N		Never use the result cache, even with -C or CSIM_CACHE.\n");
+	printf("		Setting CSIM_NOCACHE does the same.\n");
+	printf("-A <bytes>	Find the offset (and, for rows of <bytes> > 0, the row padding)\n");
+	printf("		of each -r region that minimizes misses.\n\n");
 	printf("Examples:\n");
 	printf("linux>	./test-csim -s 4 -E 1 -b 4 -t traces/yi.trace\n");
 	printf("linux>	./test-csim -v -s 8 -E 2 -b 4 -t traces/yi.trace\n");
+	printf("linux>	./test-csim -c -s 5 -E 1 -b 5 -r 0x602100:0x603100 -t trace.f0\n");
+	printf("linux>	./test-csim -s 6 -E 8 -b 6 -t a.trace -m b.trace -q 1000 -W 6,2\n");
+	printf("linux>	./test-csim -s 8 -E 4 -b 6 -t big.bin -P big.sp\n");
+	printf("linux>	./test-csim -S /tmp/csim.sock -j 8 &\n");
+	printf("linux>	./test-csim -s 5 -E 1 -b 5 -r 0x603200:0x607200 -r 0x643200:0x647200 -A 256 -t trace.f1\n");
 	return 0;
 }
 
-cache_s* create_cache(int s, int E, int b)
+cache_s* create_cache(int s, int E, int b, int lazy)
+// Returns NULL if the blocks cannot be allocated. In lazy mode the blocks are backed by an anonymous mapping, whose pages
+// the kernel zero-fills on first touch. A zeroed block is exactly an
+// invalid block with LRU 0, so nothing is initialized up front and memory
+// grows only with the sets the trace actually uses.
 {
-	int S = pow(2,s);
+	size_t S = (size_t)1 << s;
 	cache_s *cache = (cache_s*)malloc(sizeof(cache_s));
-	cache->sets = (set_s*)malloc(sizeof(set_s)*S);
+	if (cache == NULL)
+		return NULL;
 	cache->s = s;
 	cache->E = E;
 	cache->b = b;
-	// Creates the blocks within each set
-	int i,j;
-	for (i=0;i<S;i++)
-		cache->sets[i].blocks = (block_s*)malloc(sizeof(block_s)*E);
-	// Sets each block's valid bit to invalid and LRU to 0
-	for (i=0;i<S;i++)
+	cache->lazy = lazy;
+	cache->LRU = 1;
+	cache->tag_shift = s + b;
+	cache->set_mask = S - 1;
+	cache->access = pick_kernel(E);
+	cache->bytes = sizeof(block_s)*S*E;
+	if (lazy)
 	{
-		for (j=0;j<E;j++)
-		{
-			cache->sets[i].blocks[j].valid = 0;
-			cache->sets[i].blocks[j].LRU = 0;
-		}
+		cache->blocks = (block_s*)mmap(NULL, cache->bytes, PROT_READ | PROT_WRITE, \
+MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (cache->blocks == MAP_FAILED)
+			cache->blocks = NULL;
+	}
+	else
+		cache->blocks = (block_s*)malloc(cache->bytes);
+	if (cache->blocks == NULL)
+	{
+		fprintf(stderr,"Error allocating %zu bytes for the cache\n", cache->bytes);
+		free(cache);
+		return NULL;
 	}
+	if (lazy)
+		return(cache);
+	// Sets each block to invalid (LRU 0)
+	size_t i;
+	for (i=0;i<S*E;i++)
+		cache->blocks[i].LRU = 0;
 	return(cache);
 }
 
-void read_vars(int argc, char *argv[], int *s, int *E, int *b, char **trace, int *h, int *v)
-// Every variable but argc and argv are outputs to be modified
+void free_cache(cache_s *cache)
 {
-	int c;
-	while ((c = getopt(argc, argv, "sEbthv")) != -1)
+	if (cache->lazy)
+		munmap(cache->blocks, cache->bytes);
+	else
+		free(cache->blocks);
+	free(cache);
+}
+
+int read_timing(char *spec, timing_s *t)
+// Parses a -T spec such as "l1=4,mshr=10,banks=16"; an empty spec keeps the defaults
+{
+	char key[16];
+	int val, n;
+	while (*spec != '\0')
+	{
+		if (sscanf(spec, "%15[^=]=%d%n", key, &val, &n) != 2)
+			return -1;
+		if (strcmp(key, "l1") == 0) t->l1 = val;
+		else if (strcmp(key, "l2") == 0) t->l2 = val;
+		else if (strcmp(key, "mshr") == 0) t->mshrs = val;
+		else if (strcmp(key, "banks") == 0) t->banks = val;
+		else if (strcmp(key, "col") == 0) t->col_bits = val;
+		else if (strcmp(key, "hit") == 0) t->row_hit = val;
+		else if (strcmp(key, "miss") == 0) t->row_miss = val;
+		else if (strcmp(key, "conflict") == 0) t->row_conflict = val;
+		else return -1;
+		spec += n;
+		if (*spec == ',')
+			spec++;
+		else if (*spec != '\0')
+			return -1;
+	}
+	return 0;
+}
+
+int check_geometry(int s, int E, int b)
+// A geometry csim can simulate: tags and set indexes fit in an address, and
+// the cache is at most 2^MAX_BLOCK_BITS blocks
+{
+	if (s < 0 || b < 0 || E < 1 || s + b >= 64 || s > MAX_BLOCK_BITS)
+		return -1;
+	if (((unsigned long long)1 << s) * E > (1ULL << MAX_BLOCK_BITS))
+		return -1;
+	return 0;
+}
+
+int read_vars(int argc, char *argv[], opts_s *opts)
+// Fills opts from the command line; returns -1 on a malformed option
+{
+	int c, n;
+	char *end;
+	region_s *r;
+	memset(opts, 0, sizeof(opts_s));
+	opts->quantum = 1;
+	timing_s *t = &opts->timing;
+	t->l1 = 4;
+	t->l2 = 12;
+	t->mshrs = 8;
+	t->banks = 8;
+	t->col_bits = 13;
+	t->row_hit = 40;
+	t->row_miss = 80;
+	t->row_conflict = 120;
+	while ((c = getopt(argc, argv, "s:E:b:t:hvLcr:i:u2:T:m:q:W:o:P:S:j:CNA:")) != -1)
 		switch (c)
 		{
-		case 's': *s = atoi(argv[optind]);
+		case 's': opts->s = atoi(optarg);
 			break;
-		case 'E': *E = atoi(argv[optind]);
+		case 'E': opts->E = atoi(optarg);
 			break;
-		case 'b': *b = atoi(argv[optind]);
+		case 'b': opts->b = atoi(optarg);
 			break;
-		case 't': *trace = argv[optind];
+		case 't': opts->trace = optarg;
 			break;
-		case 'h': *h = 1;
+		case 'h': opts->h = 1;
+			break;
+		case 'v': opts->v = 1;
+			break;
+		case 'L': opts->L = 1;
+			break;
+		case 'c': opts->classify = 1;
+			break;
+		case 'r':
+			if (opts->nregions == MAX_REGIONS)
+				return -1;
+			r = &opts->regions[opts->nregions++];
+			r->lo = strtoull(optarg, &end, 0);
+			if (*end != ':')
+				return -1;
+			r->hi = strtoull(end + 1, &end, 0);
+			if (*end != '\0' || r->hi <= r->lo)
+				return -1;
+			break;
+		case 'i':
+			if (sscanf(optarg, "%d,%d,%d", &opts->is, &opts->iE, &opts->ib) != 3)
+				return -1;
+			opts->icache = 1;
+			break;
+		case 'u': opts->unified = 1;
+			break;
+		case '2':
+			if (sscanf(optarg, "%d,%d,%d", &opts->s2, &opts->E2, &opts->b2) != 3)
+				return -1;
+			opts->l2 = 1;
+			break;
+		case 'T':
+			opts->timed = 1;
+			if (read_timing(optarg, t) < 0)
+				return -1;
+			break;
+		case 'm':
+			// Slot 0 is reserved for the -t trace
+			if (opts->ntraces == MAX_TRACES - 1)
+				return -1;
+			opts->traces[++opts->ntraces] = optarg;
+			break;
+		case 'q': opts->quantum = atoi(optarg);
+			break;
+		case 'W':
+			for (opts->nways = 0;*optarg != '\0';opts->nways++)
+			{
+				if (opts->nways == MAX_TRACES || sscanf(optarg, "%d%n", &opts->ways[opts->nways], &n) != 1)
+					return -1;
+				optarg += n;
+				if (*optarg == ',')
+					optarg++;
+			}
 			break;
-		case 'v': *v = 1;
+		case 'o': opts->interval = atoi(optarg);
 			break;
+		case 'P': opts->points = optarg;
+			break;
+		case 'S': opts->server = optarg;
+			break;
+		case 'j': opts->workers = atoi(optarg);
+			break;
+		case 'C': opts->memo = 1;
+			break;
+		case 'N': opts->nomemo = 1;
+			break;
+		case 'A':
+			opts->advise = 1;
+			opts->row = strtoull(optarg, &end, 0);
+			if (*end != '\0')
+				return -1;
+			break;
+		default:
+			return -1;
+		}
+	// A fetch goes either to its own cache or to the data cache, not both
+	if (opts->icache && opts->unified)
+		return -1;
+	if (opts->quantum < 1)
+		return -1;
+	// Banks are selected by address bits
+	if (t->mshrs < 1 || t->banks < 1 || (t->banks & (t->banks - 1)) != 0)
+		return -1;
+	if (t->mshrs > MAX_TIMING || t->banks > MAX_TIMING || t->col_bits < 0 || t->col_bits >= 48)
+		return -1;
+	// A server takes its geometry from each query
+	if (opts->server == NULL && !opts->h && check_geometry(opts->s, opts->E, opts->b) < 0)
+		return -1;
+	if (opts->icache && check_geometry(opts->is, opts->iE, opts->ib) < 0)
+		return -1;
+	if (opts->l2 && check_geometry(opts->s2, opts->E2, opts->b2) < 0)
+		return -1;
+	return 0;
+}
+
+void free_shadow(shadow_s *sh)
+{
+	lineset_free(&sh->seen);
+	lineset_free(&sh->where);
+	free(sh->line);
+	free(sh->prev);
+	free(sh->next);
+	free(sh);
+}
+
+shadow_s* create_shadow(opts_s *opts)
+// The LRU list is grown on demand, so memory follows the lines actually
+// touched. Returns NULL if the shadow caches cannot be allocated.
+{
+	shadow_s *sh = (shadow_s*)calloc(1, sizeof(shadow_s));
+	if (sh == NULL)
+		return NULL;
+	if (lineset_init(&sh->seen, 1024) < 0 || lineset_init(&sh->where, 1024) < 0)
+	{
+		fprintf(stderr,"Error allocating shadow caches\n");
+		free_shadow(sh);
+		return NULL;
+	}
+	sh->cap = (unsigned int)(((size_t)1 << opts->s) * opts->E);
+	sh->b = opts->b;
+	sh->head = NIL;
+	sh->tail = NIL;
+	sh->nregions = opts->nregions;
+	memcpy(sh->regions, opts->regions, sizeof(sh->regions));
+	return(sh);
+}
+
+void fa_unlink(shadow_s *sh, unsigned int n)
+// Takes node n out of the LRU list
+{
+	if (sh->prev[n] != NIL)
+		sh->next[sh->prev[n]] = sh->next[n];
+	else
+		sh->head = sh->next[n];
+	if (sh->next[n] != NIL)
+		sh->prev[sh->next[n]] = sh->prev[n];
+	else
+		sh->tail = sh->prev[n];
+}
+
+void fa_push(shadow_s *sh, unsigned int n)
+// Makes node n the most recently used
+{
+	sh->prev[n] = NIL;
+	sh->next[n] = sh->head;
+	if (sh->head != NIL)
+		sh->prev[sh->head] = n;
+	sh->head = n;
+	if (sh->tail == NIL)
+		sh->tail = n;
+}
+
+int fa_access(shadow_s *sh, unsigned long long line)
+// Accesses the fully associative LRU cache; returns 1 for a hit
+{
+	int added;
+	unsigned int n;
+	unsigned int *slot = lineset_find(&sh->where, line);
+	if (slot != NULL)
+	{
+		n = *slot;
+		if (n != sh->head)
+		{
+			fa_unlink(sh, n);
+			fa_push(sh, n);
+		}
+		return 1;
+	}
+	if (sh->used < sh->cap)
+	{
+		// Still filling: take a fresh node, growing the arrays if needed
+		if (sh->used == sh->alloc)
+		{
+			sh->alloc = sh->alloc ? sh->alloc * 2 : 1024;
+			if (sh->alloc > sh->cap)
+				sh->alloc = sh->cap;
+			sh->line = (unsigned long long*)realloc(sh->line, sizeof(unsigned long long)*sh->alloc);
+			sh->prev = (unsigned int*)realloc(sh->prev, sizeof(unsigned int)*sh->alloc);
+			sh->next = (unsigned int*)realloc(sh->next, sizeof(unsigned int)*sh->alloc);
+			if (sh->line == NULL || sh->prev == NULL || sh->next == NULL)
+			{
+				fprintf(stderr,"Error allocating shadow caches\n");
+				exit(1);
+			}
 		}
+		n = sh->used++;
+	}
+	else
+	{
+		// Full: recycle the least recently used node
+		n = sh->tail;
+		fa_unlink(sh, n);
+		lineset_remove(&sh->where, sh->line[n]);
+	}
+	sh->line[n] = line;
+	fa_push(sh, n);
+	slot = lineset_insert(&sh->where, line, &added);
+	if (slot == NULL)
+	{
+		fprintf(stderr,"Error allocating shadow caches\n");
+		exit(1);
+	}
+	*slot = n;
+	return 0;
+}
+
+region_s* find_region(shadow_s *sh, unsigned long long address)
+{
+	int i;
+	for (i=0;i<sh->nregions;i++)
+		if (address >= sh->regions[i].lo && address < sh->regions[i].hi)
+			return &sh->regions[i];
+	return NULL;
+}
+
+void classify(shadow_s *sh, unsigned long long address, int result)
+// Feeds one access to the shadow caches and files a miss of the real cache
+// (result from load_store_tally) as compulsory, capacity or conflict
+{
+	int first;
+	unsigned long long line = address >> sh->b;
+	region_s *r = find_region(sh, address);
+	if (lineset_insert(&sh->seen, line, &first) == NULL)
+	{
+		fprintf(stderr,"Error allocating shadow caches\n");
+		exit(1);
+	}
+	int fa_hit = fa_access(sh, line);
+	if (result == 1)
+	{
+		if (r != NULL)
+			r->hits = r->hits + 1;
+		return;
+	}
+	if (r != NULL)
+		r->misses = r->misses + 1;
+	// Never seen before: even an infinite cache would miss
+	if (first)
+	{
+		sh->compulsory = sh->compulsory + 1;
+		if (r != NULL)
+			r->compulsory = r->compulsory + 1;
+	}
+	// A fully associative cache of the same size misses too
+	else if (!fa_hit)
+	{
+		sh->capacity = sh->capacity + 1;
+		if (r != NULL)
+			r->capacity = r->capacity + 1;
+	}
+	// Only the set mapping is to blame
+	else
+	{
+		sh->conflict = sh->conflict + 1;
+		if (r != NULL)
+			r->conflict = r->conflict + 1;
+	}
+}
+
+void print_classes(shadow_s *sh, FILE *out)
+{
+	int i;
+	region_s *r;
+	fprintf(out, "compulsory:%llu capacity:%llu conflict:%llu\n", sh->compulsory, sh->capacity, sh->conflict);
+	for (i=0;i<sh->nregions;i++)
+	{
+		r = &sh->regions[i];
+		fprintf(out, "region %d [%llx,%llx) hits:%llu misses:%llu compulsory:%llu capacity:%llu conflict:%llu\n", \
+i, r->lo, r->hi, r->hits, r->misses, r->compulsory, r->capacity, r->conflict);
+	}
 }
 
-int load_store_tally(cache_s *cache, int address, int *hits, int *misses, int *evicts, int s, int b, int S, \
-int E, int *LRU)
+int load_store_tally(cache_s *cache, unsigned long long address, unsigned long long *hits, \
+unsigned long long *misses, unsigned long long *evicts, int s, int b, unsigned long long S, int E, \
+unsigned long long *LRU)
 // Determines whether the address load/store is a hit/miss and if miss if it evicts too
 // Returns -1 for evict, 0 for miss, 1 for hit
 {
 	// First determine vars (set num, tag num)
-	int set = (address >> b) & (S - 1);
-	int tag = (address >> (s + b));
+	unsigned long long set_index = (address >> b) & (S - 1);
+	unsigned long long tag = (address >> (s + b));
+	block_s *set = &cache->blocks[set_index * E];
 
 	// Then loop through the set
-	// In loop: check valid bit/tag num
+	// In loop: check valid (nonzero LRU)/tag num
 	int i;
 	for (i=0;i<E;i++)
 	{
-		// Is the valid bit set?
-		if (cache->sets[set].blocks[i].valid == 1)
+		// Is the block valid?
+		if (set[i].LRU != 0)
 		{
-			if (cache->sets[set].blocks[i].tag == tag)
+			if (set[i].tag == tag)
 			{
 				// It's a hit!
 				*hits = *hits + 1;
-				cache->sets[set].blocks[i].LRU = *LRU;
+				set[i].LRU = *LRU;
 				*LRU = *LRU + 1;
 				return 1;
 			}
@@ -120,108 +682,1227 @@ int E, int *LRU)
 	}
 	// If miss, check for evict and change cache value (LRU)
 	int LRU_index = 0;
-	int LRU_val = INT_MAX;
+	unsigned long long LRU_val = ULLONG_MAX;
 	// Logs the Least Recently Used cache block
 	// Or if there is an invalid (open) block, fills it
 	for (i=0;i<E;i++)
 	{
 		// If the miss is not an evict (open space found)
-		if (cache->sets[set].blocks[i].valid == 0)
+		if (set[i].LRU == 0)
 		{
 			// A miss alas, but no eviction
-			cache->sets[set].blocks[i].tag = tag;
-			cache->sets[set].blocks[i].valid = 1;
-			cache->sets[set].blocks[i].LRU = *LRU;
+			set[i].tag = tag;
+			set[i].LRU = *LRU;
 			*misses = *misses + 1;
 			*LRU = *LRU + 1;
 			return 0;
 		}
 		// Else log the LRU block for eviction
-		else if (cache->sets[set].blocks[i].LRU < LRU_val)
+		else if (set[i].LRU < LRU_val)
 		{
 			LRU_index = i;
-			LRU_val = cache->sets[set].blocks[i].LRU;
+			LRU_val = set[i].LRU;
 		}
 		else;
 	}
 	// Evicts if a conflict miss
-	cache->sets[set].blocks[LRU_index].tag = tag;
-	cache->sets[set].blocks[LRU_index].LRU = *LRU;
+	set[LRU_index].tag = tag;
+	set[LRU_index].LRU = *LRU;
 	*misses = *misses + 1;
 	*evicts = *evicts + 1;
 	*LRU = *LRU + 1;
 	return -1;
 }
 
-void norm_tally(cache_s *cache, char *trace, int *hits, int *misses, int *evicts)
-// Performs the full cache test, line by line (without -v flag)
+// Specialized kernels: with E a compile-time constant and the set mask and
+// tag shift precomputed, the hit scan and the victim search collapse into one
+// fully unrolled pass. They behave exactly like load_store_tally.
+#define DEFINE_KERNEL(N) \
+int access_E##N(cache_s *cache, unsigned long long address, stats_s *stats) \
+{ \
+	unsigned long long tag = address >> cache->tag_shift; \
+	block_s *set = &cache->blocks[((address >> cache->b) & cache->set_mask) * N]; \
+	int i, empty = -1, victim = 0; \
+	_Pragma("GCC unroll 16") \
+	for (i=0;i<N;i++) \
+	{ \
+		if (set[i].LRU != 0) \
+		{ \
+			if (set[i].tag == tag) \
+			{ \
+				stats->hits++; \
+				set[i].LRU = cache->LRU++; \
+				return 1; \
+			} \
+			if (set[i].LRU < set[victim].LRU) \
+				victim = i; \
+		} \
+		else if (empty < 0) \
+			empty = i; \
+	} \
+	stats->misses++; \
+	if (empty >= 0) \
+	{ \
+		set[empty].tag = tag; \
+		set[empty].LRU = cache->LRU++; \
+		return 0; \
+	} \
+	stats->evicts++; \
+	set[victim].tag = tag; \
+	set[victim].LRU = cache->LRU++; \
+	return -1; \
+}
+
+DEFINE_KERNEL(2)
+DEFINE_KERNEL(4)
+DEFINE_KERNEL(8)
+DEFINE_KERNEL(16)
+
+int access_E1(cache_s *cache, unsigned long long address, stats_s *stats)
+// Direct mapped: one compare, and on a miss one store. The LRU field only
+// marks the block valid, as there is never a choice of victim.
 {
-	FILE *fp;
-	fp = fopen(trace,"r");
-	char line[50];
-	char cmd[5];
-	unsigned long long addr = 0;
-	int size;
-	if (fp == NULL)
+	unsigned long long tag = address >> cache->tag_shift;
+	block_s *blk = &cache->blocks[(address >> cache->b) & cache->set_mask];
+	if (blk->LRU != 0 && blk->tag == tag)
+	{
+		stats->hits++;
+		return 1;
+	}
+	stats->misses++;
+	int result = blk->LRU != 0 ? -1 : 0;
+	stats->evicts -= result;
+	blk->tag = tag;
+	blk->LRU = 1;
+	return result;
+}
+
+int access_generic(cache_s *cache, unsigned long long address, stats_s *stats)
+{
+	return load_store_tally(cache, address, &stats->hits, &stats->misses, &stats->evicts, \
+cache->s, cache->b, 1ULL << cache->s, cache->E, &cache->LRU);
+}
+
+access_fn pick_kernel(int E)
+// Chosen once per cache at startup
+{
+	switch (E)
+	{
+	case 1: return access_E1;
+	case 2: return access_E2;
+	case 4: return access_E4;
+	case 8: return access_E8;
+	case 16: return access_E16;
+	default: return access_generic;
+	}
+}
+
+int cache_access(cache_s *cache, unsigned long long address, stats_s *stats)
+// Looks address up in cache with the kernel chosen for its geometry
+{
+	return cache->access(cache, address, stats);
+}
+
+void fetch_tally(cache_s *cache, unsigned long long address, unsigned int size, stats_s *stats)
+// Simulates an instruction fetch, which touches every line from its first
+// to its last byte when it straddles a line boundary
+{
+	int b = cache->b;
+	unsigned long long line = address >> b;
+	unsigned long long last = (address + (size ? size : 1) - 1) >> b;
+	for (;line <= last;line++)
+		cache_access(cache, line << b, stats);
+}
+
+int create_timing(timing_s *t)
+// Returns -1, with nothing left allocated, if the model cannot be allocated
+{
+	int i;
+	t->open_row = (long long*)malloc(sizeof(long long)*t->banks);
+	t->mshr_done = (unsigned long long*)calloc(t->mshrs, sizeof(unsigned long long));
+	if (t->open_row == NULL || t->mshr_done == NULL)
+	{
+		fprintf(stderr,"Error allocating the timing model\n");
+		free(t->open_row);
+		free(t->mshr_done);
+		return -1;
+	}
+	// Every bank starts precharged (no open row)
+	for (i=0;i<t->banks;i++)
+		t->open_row[i] = -1;
+	return 0;
+}
+
+void free_timing(timing_s *t)
+{
+	free(t->open_row);
+	free(t->mshr_done);
+}
+
+int dram_latency(timing_s *t, unsigned long long address)
+// Column bits are lowest, then the bank, then the row
+{
+	int bank = (address >> t->col_bits) & (t->banks - 1);
+	long long row = address >> t->col_bits >> __builtin_ctz(t->banks);
+	if (t->open_row[bank] == row)
+	{
+		t->row_hits++;
+		return t->row_hit;
+	}
+	if (t->open_row[bank] == -1)
+		t->row_misses++;
+	else
+		t->row_conflicts++;
+	int lat = t->open_row[bank] == -1 ? t->row_miss : t->row_conflict;
+	t->open_row[bank] = row;
+	return lat;
+}
+
+void time_access(timing_s *t, int latency, int missed)
+// The core issues one access per cycle. Hits are waited for in order; a miss
+// only needs a free MSHR, so up to t->mshrs misses overlap.
+{
+	int i, slot = 0;
+	t->latency += latency;
+	t->accesses++;
+	if (!missed)
+	{
+		t->now += latency;
+		return;
+	}
+	for (i=1;i<t->mshrs;i++)
+		if (t->mshr_done[i] < t->mshr_done[slot])
+			slot = i;
+	// Stall until the oldest outstanding miss frees its MSHR
+	if (t->mshr_done[slot] > t->now)
+		t->now = t->mshr_done[slot];
+	t->mshr_done[slot] = t->now + latency;
+	t->now++;
+}
+
+unsigned long long total_cycles(timing_s *t)
+// Drains the outstanding misses
+{
+	int i;
+	unsigned long long end = t->now;
+	for (i=0;i<t->mshrs;i++)
+		if (t->mshr_done[i] > end)
+			end = t->mshr_done[i];
+	return end;
+}
+
+int data_access(sim_s *sim, unsigned long long address)
+// One data access through the cache hierarchy, the 3C shadows and the timing model
+{
+	int result = cache_access(sim->cache, address, &sim->data);
+	int latency;
+	if (sim->shadow != NULL)
+		classify(sim->shadow, address, result);
+	if (sim->timing == NULL)
+	{
+		// The L2 only sees L1 misses
+		if (result != 1 && sim->l2 != NULL)
+			cache_access(sim->l2, address, &sim->l2stats);
+		return result;
+	}
+	latency = sim->timing->l1;
+	if (result != 1)
+	{
+		if (sim->l2 != NULL)
+		{
+			latency += sim->timing->l2;
+			if (cache_access(sim->l2, address, &sim->l2stats) != 1)
+				latency += dram_latency(sim->timing, address);
+		}
+		else
+			latency += dram_latency(sim->timing, address);
+	}
+	time_access(sim->timing, latency, result != 1);
+	return result;
+}
+
+void fold_hits(sim_s *sim, unsigned long long address, unsigned long long n)
+// Accounts for n accesses to the line just accessed. Nothing can have evicted
+// it in between, so they are all hits and need no lookup.
+{
+	region_s *r;
+	sim->data.hits = sim->data.hits + n;
+	if (sim->shadow != NULL && (r = find_region(sim->shadow, address)) != NULL)
+		r->hits = r->hits + n;
+	if (sim->timing != NULL)
+	{
+		sim->timing->latency += n * sim->timing->l1;
+		sim->timing->accesses += n;
+		sim->timing->now += n * sim->timing->l1;
+	}
+}
+
+void tally_record(sim_s *sim, trace_rec_t *rec, unsigned long long *last_line)
+// Simulates one record. Instruction fetches are simulated only when
+// sim->icache is set; it may be the data cache itself (-u).
+// Consecutive data accesses to one line only look the first one up; the rest,
+// and any repeats folded into a record by tracefilt, are counted in bulk.
+// last_line carries the previous data line between calls.
+{
+	// if there is an instruction command, fetch it or skip to next
+	if (rec->op == 'I')
+	{
+		if (sim->icache != NULL)
+		{
+			fetch_tally(sim->icache, rec->addr, rec->size, &sim->inst);
+			// A fetch into a unified cache may have evicted the last data line
+			if (sim->icache == sim->cache)
+				*last_line = ULLONG_MAX;
+		}
+		return;
+	}
+	unsigned long long line = rec->addr >> sim->cache->b;
+	// Checks the operation.
+	//Performs two for M, one for L/S 
+	// since modify goes twice, the 2nd is a guranteed hit
+	unsigned long long extra = rec->repeat + (rec->op == 'M');
+	if (line == *last_line)
+		extra++;
+	else
+	{
+		// Data load / Data store / first half of a data modify
+		data_access(sim, rec->addr);
+		*last_line = line;
+	}
+	if (extra)
+		fold_hits(sim, rec->addr, extra);
+}
+
+void norm_tally(sim_s *sim, char *trace)
+// Performs the full cache test, record by record (without -v flag)
+// Accepts lackey text traces as well as binary traces (see trace.h)
+{
+	trace_file_t *tf = trace_open(trace);
+	trace_rec_t rec;
+	if (tf == NULL)
 	{
 		fprintf(stderr,"Error opening file");	
 		return;
 	}
-	int s = cache->s;
-	int b = cache->b;
-	int E = cache->E;
-	int S = pow(2,s);
-	int LRU = 1;
-	// Reads each line, one at a time, from file
-	while (fgets(line,50,fp) != NULL)
+	unsigned long long last_line = ULLONG_MAX;
+	// Reads each record, one at a time, from file
+	while (trace_next(tf, &rec))
+		tally_record(sim, &rec, &last_line);
+	trace_close(tf);
+}
+
+sample_s* read_points(char *file)
+// Reads a simpoint file: a header line, then "<index> <weight>" in trace order
+{
+	char unit[16];
+	unsigned long long index;
+	double weight;
+	FILE *fp = fopen(file, "r");
+	sample_s *sp = (sample_s*)calloc(1, sizeof(sample_s));
+	if (fp == NULL || sp == NULL || \
+fscanf(fp, "interval %llu %llu %15s", &sp->length, &sp->count, unit) != 3 || sp->length == 0)
+	{
+		fprintf(stderr,"Error reading simulation points from %s\n", file);
+		exit(1);
+	}
+	sp->records = strcmp(unit, "records") == 0;
+	while (fscanf(fp, "%llu %lf", &index, &weight) == 2)
+	{
+		sp->index = (unsigned long long*)realloc(sp->index, sizeof(unsigned long long)*(sp->npoints + 1));
+		sp->weight = (double*)realloc(sp->weight, sizeof(double)*(sp->npoints + 1));
+		if (sp->index == NULL || sp->weight == NULL || \
+(sp->npoints > 0 && index <= sp->index[sp->npoints - 1]))
+		{
+			fprintf(stderr,"Error reading simulation points from %s\n", file);
+			exit(1);
+		}
+		sp->index[sp->npoints] = index;
+		sp->weight[sp->npoints] = weight;
+		sp->npoints = sp->npoints + 1;
+	}
+	fclose(fp);
+	return(sp);
+}
+
+void weigh_stats(double *est, stats_s *now, stats_s *then, double weight)
+// Adds the weighted hits/misses/evictions since then to est
+{
+	est[0] += weight * (now->hits - then->hits);
+	est[1] += weight * (now->misses - then->misses);
+	est[2] += weight * (now->evicts - then->evicts);
+}
+
+void scale_stats(stats_s *stats, double *est, unsigned long long count)
+{
+	stats->hits = (unsigned long long)(est[0] * count + 0.5);
+	stats->misses = (unsigned long long)(est[1] * count + 0.5);
+	stats->evicts = (unsigned long long)(est[2] * count + 0.5);
+}
+
+void sample_enter(sim_s *sim, sample_s *sp, unsigned long long interval)
+// Called as each interval begins: closes the measured interval, if any, and
+// starts measuring if this one was chosen
+{
+	if (sp->measuring)
 	{
-		// Scans string format
-		sscanf(line," %s %llx,%d",cmd,&addr,&size);
-		// if there is an instruction command, skip to next
-		if (cmd[0] == 'I')
+		double w = sp->weight[sp->next - 1];
+		weigh_stats(sp->est[0], &sim->data, &sp->start[0], w);
+		weigh_stats(sp->est[1], &sim->inst, &sp->start[1], w);
+		weigh_stats(sp->est[2], &sim->l2stats, &sp->start[2], w);
+		sp->measuring = 0;
+	}
+	if (sp->next < sp->npoints && sp->index[sp->next] == interval)
+	{
+		sp->start[0] = sim->data;
+		sp->start[1] = sim->inst;
+		sp->start[2] = sim->l2stats;
+		sp->measuring = 1;
+		sp->next = sp->next + 1;
+	}
+}
+
+void sampled_tally(sim_s *sim, char *trace, sample_s *sp)
+// Simulates only the chosen intervals, each preceded by the interval before it
+// to warm the caches, then replaces the statistics with the weighted
+// per-interval statistics scaled up to the whole run
+{
+	trace_file_t *tf = trace_open(trace);
+	trace_rec_t rec;
+	if (tf == NULL)
+	{
+		fprintf(stderr,"Error opening file");	
+		return;
+	}
+	unsigned long long last_line = ULLONG_MAX, n = 0, interval = 0, simulated = 0, k;
+	sample_enter(sim, sp, 0);
+	// Stops reading once the last chosen interval is over
+	while ((sp->measuring || sp->next < sp->npoints) && trace_next(tf, &rec))
+	{
+		// The n-th counted record (from 0) opens interval n / length
+		if (sp->records || rec.op == 'I')
 		{
+			k = n / sp->length;
+			n = n + 1;
+			if (k != interval)
+			{
+				interval = k;
+				sample_enter(sim, sp, interval);
+			}
+		}
+		// Neither measured nor the warm-up for the next measured interval
+		if (!sp->measuring && (sp->next == sp->npoints || interval + 1 < sp->index[sp->next]))
 			continue;
+		simulated = simulated + 1;
+		tally_record(sim, &rec, &last_line);
+	}
+	sample_enter(sim, sp, ULLONG_MAX);
+	trace_close(tf);
+	scale_stats(&sim->data, sp->est[0], sp->count);
+	scale_stats(&sim->inst, sp->est[1], sp->count);
+	scale_stats(&sim->l2stats, sp->est[2], sp->count);
+	printf("simpoints:%d of %llu intervals, %llu records simulated\n", sp->npoints, sp->count, simulated);
+}
+
+int shared_tally(cache_s *cache, unsigned long long address, tenant_s *tenants, int id)
+// load_store_tally for a cache shared by several traces. Each trace is its own
+// address space, so the owner is part of the tag, and a miss may only replace
+// blocks in the trace's own ways. Evicting another trace's line is remembered
+// so that its next miss on that line is blamed on interference.
+{
+	tenant_s *me = &tenants[id];
+	unsigned long long set_index = (address >> cache->b) & cache->set_mask;
+	unsigned long long tag = (address >> cache->tag_shift) | ((unsigned long long)id << OWNER_SHIFT);
+	block_s *set = &cache->blocks[set_index * cache->E];
+	int i, added, victim = -1;
+	for (i=0;i<cache->E;i++)
+	{
+		if (set[i].LRU != 0 && set[i].tag == tag)
+		{
+			me->stats.hits = me->stats.hits + 1;
+			set[i].LRU = cache->LRU++;
+			return 1;
 		}
-		// Checks the operation.
-		//Performs two for M, one for L/S 
-		else if (cmd[0] == 'M')
+	}
+	me->stats.misses = me->stats.misses + 1;
+	if (lineset_remove(&me->stolen, address >> cache->b))
+		me->interference = me->interference + 1;
+	// Prefer an empty block, otherwise the LRU block of our partition
+	for (i=me->way_lo;i<me->way_hi;i++)
+	{
+		if (set[i].LRU == 0)
+		{
+			victim = i;
+			break;
+		}
+		if (victim == -1 || set[i].LRU < set[victim].LRU)
+			victim = i;
+	}
+	int result = 0;
+	if (set[victim].LRU != 0)
+	{
+		tenant_s *old = &tenants[set[victim].tag >> OWNER_SHIFT];
+		unsigned long long old_tag = set[victim].tag & ((1ULL << OWNER_SHIFT) - 1);
+		unsigned long long line = (old_tag << cache->s) | set_index;
+		me->stats.evicts = me->stats.evicts + 1;
+		old->occupancy = old->occupancy - 1;
+		if (old != me && lineset_insert(&old->stolen, line, &added) == NULL)
 		{
-			// Data modify
-			load_store_tally(cache, addr, hits, misses, evicts, s, b, S, E, &LRU);
-			// since modify goes twice, the 2nd is a guranteed hit
-			*hits = *hits + 1;
+			fprintf(stderr,"Error allocating interference sets\n");
+			exit(1);
 		}
+		result = -1;
+	}
+	set[victim].tag = tag;
+	set[victim].LRU = cache->LRU++;
+	me->occupancy = me->occupancy + 1;
+	return result;
+}
+
+void shared_run(cache_s *cache, opts_s *opts)
+// Interleaves every trace into one cache, -q records at a time, and reports
+// each trace's statistics. Totals go to printSummary.
+{
+	int n = opts->ntraces;
+	int i, k, way = 0, live = n;
+	unsigned long long accesses = 0;
+	trace_rec_t rec;
+	tenant_s *tenants = (tenant_s*)calloc(n, sizeof(tenant_s));
+	for (i=0;i<n;i++)
+	{
+		tenants[i].tf = trace_open(opts->traces[i]);
+		if (tenants[i].tf == NULL || lineset_init(&tenants[i].stolen, 1024) < 0)
+		{
+			fprintf(stderr,"Error opening file %s\n", opts->traces[i]);
+			exit(1);
+		}
+		// Without -W every trace may use every way
+		tenants[i].way_lo = opts->nways ? way : 0;
+		tenants[i].way_hi = opts->nways ? way + opts->ways[i] : opts->E;
+		way = tenants[i].way_hi;
+	}
+	while (live > 0)
+	{
+		for (i=0;i<n;i++)
+		{
+			if (tenants[i].tf == NULL)
+				continue;
+			for (k=0;k<opts->quantum;)
+			{
+				if (!trace_next(tenants[i].tf, &rec))
+				{
+					trace_close(tenants[i].tf);
+					tenants[i].tf = NULL;
+					live--;
+					break;
+				}
+				if (rec.op == 'I')
+					continue;
+				k++;
+				shared_tally(cache, rec.addr, tenants, i);
+				// since modify goes twice, the 2nd is a guranteed hit, as are
+				// any repeats folded in by tracefilt
+				tenants[i].stats.hits += rec.repeat + (rec.op == 'M');
+				accesses++;
+				if (opts->interval > 0 && accesses % opts->interval == 0)
+				{
+					printf("occupancy %llu", accesses);
+					for (int j=0;j<n;j++)
+						printf(" %llu", tenants[j].occupancy);
+					printf("\n");
+				}
+			}
+		}
+	}
+	stats_s total = {0, 0, 0};
+	for (i=0;i<n;i++)
+	{
+		tenant_s *t = &tenants[i];
+		total.hits += t->stats.hits;
+		total.misses += t->stats.misses;
+		total.evicts += t->stats.evicts;
+		printf("trace %d %s hits:%llu misses:%llu evictions:%llu interference:%llu occupancy:%llu\n", i, \
+opts->traces[i], t->stats.hits, t->stats.misses, t->stats.evicts, t->interference, t->occupancy);
+		lineset_free(&t->stolen);
+	}
+	printSummaryLong(total.hits, total.misses, total.evicts);
+	free(tenants);
+}
+
+// One candidate layout for the padding advisor: every address in region i is
+// moved by offset[i] bytes, plus pad[i] bytes for each row bytes before it.
+// A moved region is also lifted into tag bits of its own (REGION_SHIFT), which
+// keeps its sets but stops it from landing on the lines of other data.
+typedef struct layout_s
+{
+	unsigned long long offset[MAX_REGIONS];
+	unsigned long long pad[MAX_REGIONS];
+	cache_s *cache;
+	stats_s stats;
+} layout_s;
+
+unsigned long long relocate(opts_s *opts, layout_s *l, unsigned long long address)
+// Where address lands in layout l
+{
+	int i;
+	unsigned long long rel;
+	for (i=0;i<opts->nregions;i++)
+	{
+		region_s *r = &opts->regions[i];
+		if (address < r->lo || address >= r->hi)
+			continue;
+		if (l->offset[i] == 0 && l->pad[i] == 0)
+			return(address);
+		rel = address - r->lo;
+		if (l->pad[i] != 0)
+			rel = rel + (rel / opts->row) * l->pad[i];
+		return(r->lo + rel + l->offset[i] + ((unsigned long long)(i + 1) << REGION_SHIFT));
+	}
+	return(address);
+}
+
+void advise_pass(opts_s *opts, layout_s *layouts, int n)
+// Replays the trace once through every layout, each in its own cache
+{
+	int i;
+	trace_rec_t rec;
+	trace_file_t *tf = trace_open(opts->trace);
+	if (tf == NULL)
+	{
+		fprintf(stderr,"Error opening file %s\n", opts->trace);
+		exit(1);
+	}
+	for (i=0;i<n;i++)
+		if ((layouts[i].cache = create_cache(opts->s,opts->E,opts->b,opts->L)) == NULL)
+			exit(1);
+	while (trace_next(tf, &rec))
+	{
+		if (rec.op == 'I')
+			continue;
+		for (i=0;i<n;i++)
+		{
+			layout_s *l = &layouts[i];
+			cache_access(l->cache, relocate(opts, l, rec.addr), &l->stats);
+			// The second half of a modify and folded repeats always hit
+			l->stats.hits += rec.repeat + (rec.op == 'M');
+		}
+	}
+	trace_close(tf);
+	for (i=0;i<n;i++)
+		free_cache(layouts[i].cache);
+}
+
+void advise(opts_s *opts)
+// Padding advisor (-A). First pass: the original layout, plus every region
+// moved alone by each line-multiple offset below one cache way (and, with a
+// row size, each such padding per row). Second pass: every region at its
+// best move together, as moves that help alone may interact.
+{
+	int i, k, r, n = 1, single = 0, best_off[MAX_REGIONS], best_pad[MAX_REGIONS];
+	unsigned long long line = 1ULL << opts->b, S = 1ULL << opts->s;
+	// At most ADVISE_STEPS candidates per kind and region, evenly spaced
+	int steps = S < ADVISE_STEPS ? (int)S : ADVISE_STEPS;
+	unsigned long long step = S / steps * line;
+	int kinds = opts->row ? 2 : 1;
+	layout_s *l = (layout_s*)calloc(1 + opts->nregions * kinds * (steps - 1), sizeof(layout_s));
+	if (l == NULL)
+	{
+		fprintf(stderr,"Error allocating layouts\n");
+		exit(1);
+	}
+	for (r=0;r<opts->nregions;r++)
+		for (k=1;k<steps;k++)
+		{
+			l[n++].offset[r] = k * step;
+			if (opts->row)
+				l[n++].pad[r] = k * step;
+		}
+	advise_pass(opts, l, n);
+
+	// The summary line is the unmodified layout, as without -A
+	printSummaryLong(l[0].stats.hits, l[0].stats.misses, l[0].stats.evicts);
+	layout_s best;
+	memset(&best, 0, sizeof(layout_s));
+	for (i=1;i<n;i++)
+		if (l[i].stats.misses < l[single].stats.misses)
+			single = i;
+	for (r=0,i=1;r<opts->nregions;r++)
+	{
+		best_off[r] = 0;
+		best_pad[r] = 0;
+		for (k=1;k<steps;k++)
+		{
+			if (l[i].stats.misses < l[best_off[r]].stats.misses)
+				best_off[r] = i;
+			i = i + 1;
+			if (opts->row)
+			{
+				if (l[i].stats.misses < l[best_pad[r]].stats.misses)
+					best_pad[r] = i;
+				i = i + 1;
+			}
+		}
+		printf("region %d [%llx,%llx) offset:%llu misses:%llu", r, opts->regions[r].lo, opts->regions[r].hi, \
+l[best_off[r]].offset[r], l[best_off[r]].stats.misses);
+		if (opts->row)
+			printf(" pad:%llu misses:%llu", l[best_pad[r]].pad[r], l[best_pad[r]].stats.misses);
+		printf("\n");
+		// Keeps whichever kind of move did better on its own
+		if (l[best_pad[r]].stats.misses < l[best_off[r]].stats.misses)
+			best.pad[r] = l[best_pad[r]].pad[r];
 		else
+			best.offset[r] = l[best_off[r]].offset[r];
+	}
+	advise_pass(opts, &best, 1);
+	printf("combined");
+	for (r=0;r<opts->nregions;r++)
+		printf(" %d:+%llu/%llu", r, best.offset[r], best.pad[r]);
+	printf(" misses:%llu (was %llu)\n", best.stats.misses, l[0].stats.misses);
+	// The moves can get in each other's way; then one alone is the advice
+	if (l[single].stats.misses < best.stats.misses)
+		for (r=0;r<opts->nregions;r++)
+			if (l[single].offset[r] != 0 || l[single].pad[r] != 0)
+				printf("alone %d:+%llu/%llu misses:%llu\n", r, l[single].offset[r], l[single].pad[r], \
+l[single].stats.misses);
+	free(l);
+}
+
+void free_sim(sim_s *sim)
+// Frees whatever setup_sim managed to create
+{
+	if (sim->l2 != NULL)
+		free_cache(sim->l2);
+	if (sim->shadow != NULL)
+		free_shadow(sim->shadow);
+	if (sim->timing != NULL)
+		free_timing(sim->timing);
+	if (sim->icache != NULL && sim->icache != sim->cache)
+		free_cache(sim->icache);
+	if (sim->cache != NULL)
+		free_cache(sim->cache);
+}
+
+int setup_sim(sim_s *sim, opts_s *opts)
+// Creates the caches and analyses opts asks for. Returns -1, with nothing
+// left allocated, if any of them cannot be allocated.
+{
+	memset(sim, 0, sizeof(sim_s));
+	sim->cache = create_cache(opts->s,opts->E,opts->b,opts->L);
+	if (opts->icache)
+		sim->icache = create_cache(opts->is,opts->iE,opts->ib,opts->L);
+	else if (opts->unified)
+		sim->icache = sim->cache;
+	if (opts->l2)
+		sim->l2 = create_cache(opts->s2,opts->E2,opts->b2,opts->L);
+	if (opts->classify)
+		sim->shadow = create_shadow(opts);
+	if (opts->timed && create_timing(&opts->timing) == 0)
+		sim->timing = &opts->timing;
+	if (sim->cache == NULL || (opts->icache && sim->icache == NULL) || (opts->l2 && sim->l2 == NULL) || \
+(opts->classify && sim->shadow == NULL) || (opts->timed && sim->timing == NULL))
+	{
+		free_sim(sim);
+		return -1;
+	}
+	return 0;
+}
+
+void report(sim_s *sim, FILE *out)
+// Prints everything that follows the summary line
+{
+	if (sim->icache != NULL)
+		fprintf(out, "I-hits:%llu I-misses:%llu I-evictions:%llu\n", sim->inst.hits, sim->inst.misses, \
+sim->inst.evicts);
+	if (sim->l2 != NULL)
+		fprintf(out, "L2-hits:%llu L2-misses:%llu L2-evictions:%llu\n", sim->l2stats.hits, sim->l2stats.misses, \
+sim->l2stats.evicts);
+	if (sim->shadow != NULL)
+		print_classes(sim->shadow, out);
+	if (sim->timing != NULL)
+	{
+		timing_s *t = sim->timing;
+		fprintf(out, "cycles:%llu amat:%.2f dram-row-hits:%llu dram-row-misses:%llu dram-row-conflicts:%llu\n", \
+total_cycles(t), t->accesses ? (double)t->latency / t->accesses : 0.0, t->row_hits, t->row_misses, \
+t->row_conflicts);
+	}
+}
+
+unsigned long long digest_add(unsigned long long h, const unsigned char *p, size_t n)
+// FNV-1a, a word at a time; the tail goes byte by byte
+{
+	unsigned long long w;
+	for (;n >= 8;p += 8, n -= 8)
+	{
+		memcpy(&w, p, 8);
+		h = (h ^ w) * 0x100000001b3ULL;
+		h ^= h >> 29;
+	}
+	for (;n > 0;p++, n--)
+		h = (h ^ *p) * 0x100000001b3ULL;
+	return h;
+}
+
+int trace_digest(char *trace, unsigned long long *digest)
+// Digest of the trace contents. It is kept in a <trace>.digest sidecar with
+// the file's size and mtime, and taken from there while those still match.
+// Returns -1 if the trace cannot be read.
+{
+	struct stat st;
+	char side[PATH_MAX];
+	long long size, sec, nsec;
+	size_t n;
+	FILE *fp;
+	if (stat(trace, &st) < 0 || snprintf(side, sizeof(side), "%s.digest", trace) >= (int)sizeof(side))
+		return -1;
+	if ((fp = fopen(side, "r")) != NULL)
+	{
+		int ok = fscanf(fp, "%llx %lld %lld %lld", digest, &size, &sec, &nsec) == 4 && \
+size == (long long)st.st_size && sec == (long long)st.st_mtim.tv_sec && nsec == (long long)st.st_mtim.tv_nsec;
+		fclose(fp);
+		if (ok)
+			return 0;
+	}
+	unsigned char *buf = (unsigned char*)malloc(1 << 20);
+	if (buf == NULL || (fp = fopen(trace, "r")) == NULL)
+	{
+		free(buf);
+		return -1;
+	}
+	*digest = 0xcbf29ce484222325ULL;
+	while ((n = fread(buf, 1, 1 << 20, fp)) > 0)
+		*digest = digest_add(*digest, buf, n);
+	fclose(fp);
+	free(buf);
+	// The sidecar is only a shortcut; a read-only directory just means rehashing
+	if ((fp = fopen(side, "w")) != NULL)
+	{
+		fprintf(fp, "%016llx %lld %lld %lld\n", *digest, (long long)st.st_size, (long long)st.st_mtim.tv_sec, \
+(long long)st.st_mtim.tv_nsec);
+		fclose(fp);
+	}
+	return 0;
+}
+
+int memo_key(opts_s *opts, char *key)
+// Names the memo entry for this run: the trace digest and a digest of every
+// option that changes the output and of the binary itself, so a rebuilt csim
+// never replays an older one's results. Returns -1 if the run is not memoized.
+{
+	char config[1024];
+	int i, len;
+	unsigned long long digest;
+	struct stat exe;
+	timing_s *t = &opts->timing;
+	if (!(opts->memo || getenv("CSIM_CACHE") != NULL) || opts->nomemo || getenv("CSIM_NOCACHE") != NULL || \
+opts->trace == NULL || opts->points != NULL || opts->advise)
+		return -1;
+	if (stat("/proc/self/exe", &exe) < 0 || trace_digest(opts->trace, &digest) < 0)
+		return -1;
+	len = snprintf(config, sizeof(config), "v2 exe=%lld:%lld.%09lld:%llu s=%d E=%d b=%d c=%d i=%d:%d,%d,%d u=%d \
+l2=%d:%d,%d,%d", (long long)exe.st_size, (long long)exe.st_mtim.tv_sec, (long long)exe.st_mtim.tv_nsec, \
+(unsigned long long)exe.st_ino, opts->s, opts->E, opts->b, opts->classify, opts->icache, opts->is, opts->iE, \
+opts->ib, opts->unified, opts->l2, opts->s2, opts->E2, opts->b2);
+	if (opts->timed)
+		len += snprintf(config + len, sizeof(config) - len, " T=%d,%d,%d,%d,%d,%d,%d,%d", t->l1, t->l2, \
+t->mshrs, t->banks, t->col_bits, t->row_hit, t->row_miss, t->row_conflict);
+	for (i=0;i<opts->nregions;i++)
+		len += snprintf(config + len, sizeof(config) - len, " r=%llx:%llx", opts->regions[i].lo, \
+opts->regions[i].hi);
+	sprintf(key, MEMO_DIR "/%016llx-%016llx", digest, \
+digest_add(0xcbf29ce484222325ULL, (unsigned char*)config, strlen(config)));
+	return 0;
+}
+
+int memo_replay(char *key)
+// Prints a memoized run exactly as the simulation would; returns 1 on a hit
+{
+	char line[1024];
+	unsigned long long hits, misses, evicts;
+	FILE *fp = fopen(key, "r");
+	if (fp == NULL)
+		return 0;
+	if (fgets(line, sizeof(line), fp) == NULL || \
+sscanf(line, "hits:%llu misses:%llu evictions:%llu", &hits, &misses, &evicts) != 3)
+	{
+		fclose(fp);
+		return 0;
+	}
+	printSummaryLong(hits, misses, evicts);
+	while (fgets(line, sizeof(line), fp) != NULL)
+		fputs(line, stdout);
+	fclose(fp);
+	return 1;
+}
+
+void memo_store(char *key, sim_s *sim)
+// Writes the run's output under key. A private temporary file is renamed into
+// place so that concurrent runs never see half an entry.
+{
+	char tmp[PATH_MAX];
+	FILE *fp;
+	mkdir(MEMO_DIR, 0777);
+	snprintf(tmp, sizeof(tmp), "%s.%d", key, (int)getpid());
+	if ((fp = fopen(tmp, "w")) == NULL)
+		return;
+	fprintf(fp, "hits:%llu misses:%llu evictions:%llu\n", sim->data.hits, sim->data.misses, sim->data.evicts);
+	report(sim, fp);
+	if (fclose(fp) != 0 || rename(tmp, key) != 0)
+		unlink(tmp);
+}
+
+// A trace decoded into memory by the server. When the file changes (test-trans
+// rewrites trace.f0 for every function) it is loaded again; the old copy is
+// freed once the last query still using it is done.
+typedef struct loaded_s
+{
+	char *path;
+	struct stat st;
+	trace_rec_t *recs;
+	size_t n;
+	int refs;
+	int stale;
+	struct loaded_s *next;
+} loaded_s;
+
+// State shared by the server threads: accepted connections waiting for a
+// worker, and the loaded traces
+typedef struct server_s
+{
+	pthread_mutex_t lock;
+	pthread_cond_t ready;
+	pthread_cond_t room;
+	int queue[SERVER_QUEUE];
+	int head;
+	int count;
+	loaded_s *traces;
+	// getopt keeps its state in globals, so queries are parsed one at a time
+	pthread_mutex_t parse;
+} server_s;
+
+loaded_s* load_trace(char *path, struct stat *st)
+// Reads a whole trace into one array of records
+{
+	trace_file_t *tf = trace_open(path);
+	size_t alloc = 4096;
+	loaded_s *l = (loaded_s*)calloc(1, sizeof(loaded_s));
+	if (tf == NULL || l == NULL)
+	{
+		if (tf != NULL)
+			trace_close(tf);
+		free(l);
+		return NULL;
+	}
+	l->path = strdup(path);
+	l->st = *st;
+	l->recs = (trace_rec_t*)malloc(sizeof(trace_rec_t)*alloc);
+	while (l->recs != NULL && trace_next(tf, &l->recs[l->n]))
+	{
+		l->n = l->n + 1;
+		if (l->n == alloc)
+		{
+			alloc = alloc * 2;
+			l->recs = (trace_rec_t*)realloc(l->recs, sizeof(trace_rec_t)*alloc);
+		}
+	}
+	trace_close(tf);
+	if (l->recs == NULL || l->path == NULL)
+	{
+		fprintf(stderr,"Error allocating trace %s\n", path);
+		exit(1);
+	}
+	return(l);
+}
+
+void free_loaded(loaded_s *l)
+{
+	free(l->path);
+	free(l->recs);
+	free(l);
+}
+
+int same_file(struct stat *a, struct stat *b)
+{
+	return a->st_dev == b->st_dev && a->st_ino == b->st_ino && a->st_size == b->st_size && \
+a->st_mtim.tv_sec == b->st_mtim.tv_sec && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+loaded_s* get_trace(server_s *srv, char *path)
+// Returns the loaded trace for path, loading it if it is new or has changed.
+// Loads happen under the lock; each trace is only loaded once per change.
+{
+	struct stat st;
+	loaded_s *l, **prev;
+	if (stat(path, &st) < 0)
+		return NULL;
+	pthread_mutex_lock(&srv->lock);
+	for (prev = &srv->traces;(l = *prev) != NULL;prev = &l->next)
+	{
+		if (strcmp(l->path, path) != 0)
+			continue;
+		if (same_file(&l->st, &st))
 		{
-			// Data load / Data store
-			load_store_tally(cache, addr, hits, misses, evicts, s, b, S, E, &LRU);
+			l->refs = l->refs + 1;
+			pthread_mutex_unlock(&srv->lock);
+			return(l);
 		}
+		*prev = l->next;
+		l->stale = 1;
+		if (l->refs == 0)
+			free_loaded(l);
+		break;
 	}
+	l = load_trace(path, &st);
+	if (l != NULL)
+	{
+		l->refs = 1;
+		l->next = srv->traces;
+		srv->traces = l;
+	}
+	pthread_mutex_unlock(&srv->lock);
+	return(l);
+}
+
+void put_trace(server_s *srv, loaded_s *l)
+{
+	pthread_mutex_lock(&srv->lock);
+	l->refs = l->refs - 1;
+	if (l->stale && l->refs == 0)
+		free_loaded(l);
+	pthread_mutex_unlock(&srv->lock);
+}
+
+void serve_query(server_s *srv, int fd)
+// Answers one query: a line of csim options, answered with csim's output or
+// a line starting with "error:"
+{
+	char line[4096], *argv[MAX_ARGS], *save;
+	int argc = 0, rc;
+	size_t len = 0;
+	ssize_t got;
+	opts_s opts;
+	FILE *out = fdopen(fd, "w");
+	if (out == NULL)
+	{
+		close(fd);
+		return;
+	}
+	// Reads up to the newline that ends the query
+	while (len < sizeof(line) - 1 && (got = read(fd, line + len, sizeof(line) - 1 - len)) > 0)
+	{
+		len = len + got;
+		if (memchr(line, '\n', len) != NULL)
+			break;
+	}
+	line[len] = '\0';
+	argv[argc++] = "csim";
+	for (char *tok = strtok_r(line, " \t\r\n", &save);tok != NULL && argc < MAX_ARGS - 1;\
+tok = strtok_r(NULL, " \t\r\n", &save))
+		argv[argc++] = tok;
+	argv[argc] = NULL;
+
+	pthread_mutex_lock(&srv->parse);
+	optind = 0;
+	opterr = 0;
+	rc = read_vars(argc, argv, &opts);
+	pthread_mutex_unlock(&srv->parse);
+	if (rc < 0 || opts.h || opts.trace == NULL || opts.ntraces > 0 || opts.points != NULL || opts.server != NULL || \
+opts.advise)
+	{
+		fprintf(out, "error: bad query (bad options or cache geometry; -m, -P, -S and -A are not served)\n");
+		fclose(out);
+		return;
+	}
+	loaded_s *l = get_trace(srv, opts.trace);
+	if (l == NULL)
+	{
+		fprintf(out, "error: cannot read %s\n", opts.trace);
+		fclose(out);
+		return;
+	}
+
+	sim_s sim;
+	size_t i;
+	unsigned long long last_line = ULLONG_MAX;
+	if (setup_sim(&sim, &opts) < 0)
+	{
+		put_trace(srv, l);
+		fprintf(out, "error: cannot allocate the cache\n");
+		fclose(out);
+		return;
+	}
+	for (i=0;i<l->n;i++)
+		tally_record(&sim, &l->recs[i], &last_line);
+	put_trace(srv, l);
+	fprintf(out, "hits:%llu misses:%llu evictions:%llu\n", sim.data.hits, sim.data.misses, sim.data.evicts);
+	report(&sim, out);
+	free_sim(&sim);
+	fclose(out);
+}
+
+void* serve_worker(void *arg)
+{
+	server_s *srv = (server_s*)arg;
+	int fd;
+	while (1)
+	{
+		pthread_mutex_lock(&srv->lock);
+		while (srv->count == 0)
+			pthread_cond_wait(&srv->ready, &srv->lock);
+		fd = srv->queue[srv->head];
+		srv->head = (srv->head + 1) % SERVER_QUEUE;
+		srv->count = srv->count - 1;
+		pthread_cond_signal(&srv->room);
+		pthread_mutex_unlock(&srv->lock);
+		serve_query(srv, fd);
+	}
+	return NULL;
+}
+
+int serve(opts_s *opts)
+// Listens on the -S socket and hands each connection to a pool of -j workers.
+// Runs until killed.
+{
+	int i, fd, conn;
+	pthread_t tid;
+	struct sockaddr_un addr;
+	server_s *srv = (server_s*)calloc(1, sizeof(server_s));
+	int workers = opts->workers > 0 ? opts->workers : (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (workers < 1)
+		workers = 1;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (srv == NULL || strlen(opts->server) >= sizeof(addr.sun_path))
+	{
+		fprintf(stderr,"Error: bad socket path %s\n", opts->server);
+		return 1;
+	}
+	strcpy(addr.sun_path, opts->server);
+	pthread_mutex_init(&srv->lock, NULL);
+	pthread_mutex_init(&srv->parse, NULL);
+	pthread_cond_init(&srv->ready, NULL);
+	pthread_cond_init(&srv->room, NULL);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(opts->server);
+	if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, SERVER_QUEUE) < 0)
+	{
+		perror("csim server");
+		return 1;
+	}
+	// A client that hangs up early must not kill the server
+	signal(SIGPIPE, SIG_IGN);
+	for (i=0;i<workers;i++)
+		if (pthread_create(&tid, NULL, serve_worker, srv) != 0)
+		{
+			perror("csim server");
+			return 1;
+		}
+	printf("serving on %s with %d workers\n", opts->server, workers);
+	fflush(stdout);
+
+	while (1)
+	{
+		conn = accept(fd, NULL, NULL);
+		if (conn < 0)
+			continue;
+		pthread_mutex_lock(&srv->lock);
+		while (srv->count == SERVER_QUEUE)
+			pthread_cond_wait(&srv->room, &srv->lock);
+		srv->queue[(srv->head + srv->count) % SERVER_QUEUE] = conn;
+		srv->count = srv->count + 1;
+		pthread_cond_signal(&srv->ready);
+		pthread_mutex_unlock(&srv->lock);
+	}
+	return 0;
 }
 
 int main(int argc, char *argv[])
 {
 	// Create variables for each flag, input, and the trace
 	// Then fill them with read_vars
-	int s, E, b;
-	int h = 0;
-	int v = 0;
-	char *tracefile = (char*)malloc(sizeof(char)*50);
-	read_vars(argc, argv, &s, &E, &b, &tracefile, &h, &v);
+	opts_s opts;
+	if (read_vars(argc, argv, &opts) < 0)
+	{
+		helpmsg();
+		return 1;
+	}
 
 	// check if the help flag is set
-	if (h == 1)
+	if (opts.h == 1)
 		return(helpmsg());
+	if (opts.server != NULL)
+		return(serve(&opts));
 
 	/* The cache is initialized as a
 	new data structure */
-	cache_s *cache = create_cache(s,E,b);
+	if (opts.ntraces > 0)
+	{
+		int i, ways = 0;
+		opts.traces[0] = opts.trace;
+		opts.ntraces++;
+		for (i=0;i<opts.nways;i++)
+			ways += opts.ways[i] > 0 ? opts.ways[i] : opts.E + 1;
+		// A partition needs at least one way for every trace, and no more ways than exist
+		if ((opts.nways != 0 && (opts.nways != opts.ntraces || ways > opts.E)) || \
+opts.classify || opts.timed || opts.icache || opts.unified || opts.l2 || opts.points || opts.advise)
+		{
+			fprintf(stderr,"-m takes -W with one positive way count per trace and no -c, -T, -i, -u, -2, -P or -A\n");
+			return 1;
+		}
+		// Shorter offsets and indexes leave tags that run into the owner bits
+		if (opts.s + opts.b < 64 - OWNER_SHIFT)
+		{
+			fprintf(stderr,"-m needs s + b >= %d\n", 64 - OWNER_SHIFT);
+			return 1;
+		}
+		cache_s *shared = create_cache(opts.s,opts.E,opts.b,opts.L);
+		if (shared == NULL)
+			return 1;
+		shared_run(shared, &opts);
+		free_cache(shared);
+		return 0;
+	}
+	if (opts.advise)
+	{
+		if (opts.nregions == 0 || opts.classify || opts.timed || opts.icache || opts.unified || opts.l2 || \
+opts.points)
+		{
+			fprintf(stderr,"-A takes at least one -r region and no -c, -T, -i, -u, -2 or -P\n");
+			return 1;
+		}
+		advise(&opts);
+		return 0;
+	}
+	// An identical earlier run answers at once
+	char key[sizeof(MEMO_DIR) + 40];
+	int memo = memo_key(&opts, key) == 0;
+	if (memo && memo_replay(key))
+		return 0;
+	sim_s sim;
+	if (setup_sim(&sim, &opts) < 0)
+		return 1;
 
-	int hits = 0;
-	int misses = 0;
-	int evicts = 0;
-	norm_tally(cache, tracefile, &hits, &misses, &evicts);   
+	if (opts.points != NULL)
+	{
+		// Cycle counts and miss classes cannot be scaled from a sample
+		if (opts.classify || opts.timed)
+		{
+			fprintf(stderr,"-P cannot be combined with -c or -T\n");
+			return 1;
+		}
+		sample_s *sp = read_points(opts.points);
+		sampled_tally(&sim, opts.trace, sp);
+		free(sp->index);
+		free(sp->weight);
+		free(sp);
+	}
+	else
+		norm_tally(&sim, opts.trace);   
 
-	printSummary(hits, misses, evicts);
+	// The summary always covers data accesses only, as the graders expect
+	printSummaryLong(sim.data.hits, sim.data.misses, sim.data.evicts);
+	report(&sim, stdout);
+	if (memo)
+		memo_store(key, &sim);
+	free_sim(&sim);
 	return 0;
 }
@@ -0,0 +1,135 @@
+/*
+ * lineset.c - Compact hash map from cache-line addresses (see lineset.h)
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "lineset.h"
+
+/* Grow once the table is more than half full */
+#define MAX_LOAD(mask) (((mask) + 1) / 2)
+
+static inline size_t slot_of(const lineset_t *set, uint64_t line)
+{
+    /* Fibonacci hashing: the top bits of the product are the well mixed
+       ones, so consecutive line numbers land far apart */
+    return (size_t)((line * 0x9E3779B97F4A7C15ULL) >> set->shift);
+}
+
+int lineset_init(lineset_t *set, size_t capacity)
+{
+    size_t n = 16;
+    int bits = 4;
+    while (n < capacity) {
+        n <<= 1;
+        bits++;
+    }
+    set->keys = (uint64_t*)calloc(n, sizeof(uint64_t));
+    set->vals = (uint32_t*)calloc(n, sizeof(uint32_t));
+    set->mask = n - 1;
+    set->shift = 64 - bits;
+    set->count = 0;
+    if (set->keys == NULL || set->vals == NULL) {
+        lineset_free(set);
+        return -1;
+    }
+    return 0;
+}
+
+void lineset_free(lineset_t *set)
+{
+    free(set->keys);
+    free(set->vals);
+    set->keys = NULL;
+    set->vals = NULL;
+}
+
+uint32_t *lineset_find(lineset_t *set, uint64_t line)
+{
+    size_t i = slot_of(set, line);
+    uint64_t key = line + 1;
+    while (set->keys[i] != 0) {
+        if (set->keys[i] == key)
+            return &set->vals[i];
+        i = (i + 1) & set->mask;
+    }
+    return NULL;
+}
+
+/*
+ * grow - Rehash every entry into a table twice the size
+ */
+static int grow(lineset_t *set)
+{
+    lineset_t bigger;
+    size_t i, j;
+
+    if (lineset_init(&bigger, (set->mask + 1) * 2) < 0)
+        return -1;
+    for (i = 0; i <= set->mask; i++) {
+        if (set->keys[i] == 0)
+            continue;
+        j = slot_of(&bigger, set->keys[i] - 1);
+        while (bigger.keys[j] != 0)
+            j = (j + 1) & bigger.mask;
+        bigger.keys[j] = set->keys[i];
+        bigger.vals[j] = set->vals[i];
+    }
+    bigger.count = set->count;
+    lineset_free(set);
+    *set = bigger;
+    return 0;
+}
+
+uint32_t *lineset_insert(lineset_t *set, uint64_t line, int *added)
+{
+    size_t i;
+    uint64_t key = line + 1;
+
+    if (set->count >= MAX_LOAD(set->mask) && grow(set) < 0)
+        return NULL;
+    i = slot_of(set, line);
+    while (set->keys[i] != 0) {
+        if (set->keys[i] == key) {
+            *added = 0;
+            return &set->vals[i];
+        }
+        i = (i + 1) & set->mask;
+    }
+    set->keys[i] = key;
+    set->vals[i] = 0;
+    set->count++;
+    *added = 1;
+    return &set->vals[i];
+}
+
+/*
+ * lineset_remove - Backward-shift deletion: entries after the hole that
+ *     would no longer be reachable from their home slot are moved into it
+ */
+int lineset_remove(lineset_t *set, uint64_t line)
+{
+    size_t i = slot_of(set, line), j, home;
+    uint64_t key = line + 1;
+
+    while (set->keys[i] != key) {
+        if (set->keys[i] == 0)
+            return 0;
+        i = (i + 1) & set->mask;
+    }
+    j = i;
+    for (;;) {
+        j = (j + 1) & set->mask;
+        if (set->keys[j] == 0)
+            break;
+        home = slot_of(set, set->keys[j] - 1);
+        /* Move j back unless its home lies cyclically in (i, j] */
+        if (i <= j ? (home <= i || home > j) : (home <= i && home > j)) {
+            set->keys[i] = set->keys[j];
+            set->vals[i] = set->vals[j];
+            i = j;
+        }
+    }
+    set->keys[i] = 0;
+    set->count--;
+    return 1;
+}
@@ -0,0 +1,40 @@
+/*
+ * lineset.h - Compact hash map from cache-line addresses to 32-bit values
+ *
+ * Used for the shadow structures of the simulator: as a plain set (the
+ * values are ignored) it records every line a trace has touched, and as
+ * a map it indexes the nodes of a fully associative LRU list. Keys are
+ * stored in open-addressed tables with linear probing, so each entry
+ * costs 12 bytes and deletion needs no tombstones.
+ */
+#ifndef CSIM_LINESET_H
+#define CSIM_LINESET_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct lineset {
+    uint64_t *keys;     /* key + 1, so that 0 marks an empty slot */
+    uint32_t *vals;
+    size_t mask;        /* capacity - 1; capacity is a power of two */
+    int shift;          /* 64 - log2(capacity), for slot_of */
+    size_t count;
+} lineset_t;
+
+int lineset_init(lineset_t *set, size_t capacity);
+void lineset_free(lineset_t *set);
+
+/* Returns a pointer to the value for line, or NULL if absent */
+uint32_t *lineset_find(lineset_t *set, uint64_t line);
+
+/*
+ * Inserts line if absent. Returns a pointer to its value and sets *added
+ * to 1 if the line was new (its value is then 0). Returns NULL if the
+ * table could not grow.
+ */
+uint32_t *lineset_insert(lineset_t *set, uint64_t line, int *added);
+
+/* Removes line; returns 1 if it was present */
+int lineset_remove(lineset_t *set, uint64_t line);
+
+#endif /* CSIM_LINESET_H */
@@ -0,0 +1,395 @@
+/*
+ * mrc.c - Approximate LRU miss-ratio curves with SHARDS sampling.
+ *
+ * One pass over a trace gives the miss ratio of a fully associative LRU
+ * cache of every size, from the reuse (stack) distance of each access:
+ * an access hits in a cache of C lines exactly when fewer than C other
+ * lines were touched since the previous access to its line.
+ *
+ * Following Waldspurger et al., "Efficient MRC Construction with SHARDS"
+ * (FAST '15), only lines with hash(line) mod P < T are tracked, and the
+ * distances measured among them are scaled up by 1/R, R = T/P. With a
+ * fixed size (-s) at most that many lines are kept: when one more
+ * arrives, the lines with the largest hash are dropped and T falls to
+ * that hash, so memory stays constant however long the trace is. Each
+ * sampled access is weighted by 1/R at the time it is seen, and the
+ * difference between the expected and actual number of accesses is
+ * credited to distance 0 (SHARDS-adj).
+ *
+ * Distances are counted with a Fenwick tree over access timestamps,
+ * renumbered when they run out. The histogram has 8 buckets per power
+ * of two, so curves are reported at those sizes. -e also runs an exact
+ * analysis in the same pass and reports the error of the sampled curve
+ * at the sizes it can resolve, 1/R lines and up.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <stdint.h>
+#include "trace.h"
+#include "lineset.h"
+
+/* Hash values are taken modulo P = 2^P_BITS */
+#define P_BITS 24
+#define P ((uint64_t)1 << P_BITS)
+
+/* Distances below 16 get a bucket each, then 8 per power of two */
+#define NBUCKETS (16 + 60 * 8)
+
+typedef struct heap_ent {
+    uint32_t hash;
+    uint64_t line;
+} heap_ent;
+
+typedef struct shards_t {
+    uint64_t T;             /* sample lines with hash < T */
+    size_t smax;            /* most lines kept, 0 for no limit */
+
+    lineset_t lines;        /* sampled line -> timestamp */
+    int32_t *fen;           /* Fenwick tree of live timestamps, 1-based */
+    uint64_t *owner;        /* line stamped at each timestamp */
+    uint32_t cap, now, live;
+
+    heap_ent *heap;         /* max-heap on hash, for fixed-size eviction */
+    size_t nheap, aheap;
+
+    double hist[NBUCKETS];
+    double cold;            /* weight of first accesses */
+    double weight;          /* sum of all weights */
+} shards_t;
+
+static inline uint32_t hash_line(uint64_t x)
+{
+    /* splitmix64 finalizer */
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return (uint32_t)(x & (P - 1));
+}
+
+static int bucket_of(uint64_t d)
+{
+    int e;
+    if (d < 16)
+        return (int)d;
+    e = 63 - __builtin_clzll(d);
+    return 16 + (e - 4) * 8 + (int)((d >> (e - 3)) & 7);
+}
+
+/* Smallest distance in bucket k */
+static uint64_t bucket_lo(int k)
+{
+    if (k < 16)
+        return k;
+    return (uint64_t)(8 + (k - 16) % 8) << ((k - 16) / 8 + 1);
+}
+
+static void fen_add(shards_t *sh, uint32_t i, int v)
+{
+    for (i++; i <= sh->cap; i += i & -i)
+        sh->fen[i] += v;
+}
+
+/* Number of live timestamps <= i */
+static uint32_t fen_prefix(shards_t *sh, uint32_t i)
+{
+    uint32_t n = 0;
+    for (i++; i > 0; i -= i & -i)
+        n += sh->fen[i];
+    return n;
+}
+
+/*
+ * compact - Renumber the live timestamps 0..live-1, in order, doubling
+ *     the tree first if more than half of it would still be in use
+ */
+static int compact(shards_t *sh)
+{
+    uint32_t t, n = 0, cap = sh->cap;
+    uint32_t *ts;
+
+    while (sh->live * 2 > cap)
+        cap *= 2;
+    for (t = 0; t < sh->now; t++) {
+        /* A timestamp is live if it is still its line's latest */
+        ts = lineset_find(&sh->lines, sh->owner[t]);
+        if (ts != NULL && *ts == t) {
+            *ts = n;
+            sh->owner[n++] = sh->owner[t];
+        }
+    }
+    if (cap != sh->cap) {
+        sh->owner = (uint64_t*)realloc(sh->owner, sizeof(uint64_t) * cap);
+        free(sh->fen);
+        sh->fen = (int32_t*)malloc(sizeof(int32_t) * (cap + 1));
+        if (sh->owner == NULL || sh->fen == NULL)
+            return -1;
+        sh->cap = cap;
+    }
+    /* Rebuild the tree over n ones in linear time */
+    memset(sh->fen, 0, sizeof(int32_t) * (sh->cap + 1));
+    for (t = 1; t <= sh->cap; t++) {
+        sh->fen[t] += t <= n;
+        if (t + (t & -t) <= sh->cap)
+            sh->fen[t + (t & -t)] += sh->fen[t];
+    }
+    sh->now = n;
+    return 0;
+}
+
+static int heap_push(shards_t *sh, uint32_t hash, uint64_t line)
+{
+    size_t i;
+    if (sh->nheap == sh->aheap) {
+        sh->aheap = sh->aheap ? sh->aheap * 2 : 1024;
+        sh->heap = (heap_ent*)realloc(sh->heap, sizeof(heap_ent) * sh->aheap);
+        if (sh->heap == NULL)
+            return -1;
+    }
+    for (i = sh->nheap++; i > 0 && sh->heap[(i - 1) / 2].hash < hash; i = (i - 1) / 2)
+        sh->heap[i] = sh->heap[(i - 1) / 2];
+    sh->heap[i].hash = hash;
+    sh->heap[i].line = line;
+    return 0;
+}
+
+static heap_ent heap_pop(shards_t *sh)
+{
+    heap_ent top = sh->heap[0], last = sh->heap[--sh->nheap];
+    size_t i = 0, c;
+    while ((c = 2 * i + 1) < sh->nheap) {
+        if (c + 1 < sh->nheap && sh->heap[c + 1].hash > sh->heap[c].hash)
+            c++;
+        if (sh->heap[c].hash <= last.hash)
+            break;
+        sh->heap[i] = sh->heap[c];
+        i = c;
+    }
+    if (sh->nheap)
+        sh->heap[i] = last;
+    return top;
+}
+
+static int shards_init(shards_t *sh, double rate, size_t smax)
+{
+    memset(sh, 0, sizeof(*sh));
+    sh->T = (uint64_t)(rate * P);
+    sh->smax = smax;
+    sh->cap = 1024;
+    while (smax && sh->cap < 2 * smax + 2)
+        sh->cap *= 2;
+    sh->fen = (int32_t*)calloc(sh->cap + 1, sizeof(int32_t));
+    sh->owner = (uint64_t*)malloc(sizeof(uint64_t) * sh->cap);
+    if (sh->fen == NULL || sh->owner == NULL)
+        return -1;
+    return lineset_init(&sh->lines, smax ? smax * 2 : 1024);
+}
+
+static void shards_free(shards_t *sh)
+{
+    lineset_free(&sh->lines);
+    free(sh->fen);
+    free(sh->owner);
+    free(sh->heap);
+}
+
+/*
+ * shards_evict - Drop the lines with the largest hash and lower T to it
+ */
+static void shards_evict(shards_t *sh)
+{
+    uint32_t *ts;
+    heap_ent e;
+
+    sh->T = sh->heap[0].hash;
+    while (sh->nheap && sh->heap[0].hash >= sh->T) {
+        e = heap_pop(sh);
+        ts = lineset_find(&sh->lines, e.line);
+        fen_add(sh, *ts, -1);
+        sh->live--;
+        lineset_remove(&sh->lines, e.line);
+    }
+}
+
+/*
+ * shards_access - Account for one access to line, plus extra accesses
+ *     right after it that are certain hits
+ */
+static int shards_access(shards_t *sh, uint64_t line, uint64_t extra)
+{
+    uint32_t h = hash_line(line), *ts, d;
+    double w, scaled;
+    int added;
+
+    if (h >= sh->T)
+        return 0;
+    w = (double)P / sh->T;
+    if ((ts = lineset_insert(&sh->lines, line, &added)) == NULL)
+        return -1;
+    if (added) {
+        sh->cold += w;
+        if (sh->smax && heap_push(sh, h, line) < 0)
+            return -1;
+    } else {
+        /* Distinct sampled lines touched since this one */
+        d = sh->live - fen_prefix(sh, *ts);
+        scaled = d * w + 0.5;
+        sh->hist[bucket_of((uint64_t)scaled)] += w;
+        fen_add(sh, *ts, -1);
+        sh->live--;
+    }
+    /* Not live until restamped, should compact run first */
+    *ts = UINT32_MAX;
+    if (sh->now == sh->cap && compact(sh) < 0)
+        return -1;
+    *ts = sh->now;
+    sh->owner[sh->now] = line;
+    fen_add(sh, sh->now++, 1);
+    sh->live++;
+    sh->hist[0] += extra * w;
+    sh->weight += (1 + extra) * w;
+
+    if (sh->smax && sh->lines.count > sh->smax)
+        shards_evict(sh);
+    return 0;
+}
+
+/*
+ * miss_ratio - Miss ratio of a cache of bucket_lo(k) lines
+ */
+static double miss_ratio(const shards_t *sh, int k, double total)
+{
+    double m = sh->cold;
+    for (; k < NBUCKETS; k++)
+        m += sh->hist[k];
+    return total > 0 ? m / total : 0;
+}
+
+/*
+ * usage - Print usage info
+ */
+void usage(char *argv[])
+{
+    printf("Usage: %s [-he] -t <file> -b <num> [-r <rate>] [-s <num>] [-o <file>]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h          Print this help message.\n");
+    printf("  -t <file>   Trace (text or binary); data accesses only.\n");
+    printf("  -b <num>    Number of block offset bits.\n");
+    printf("  -r <rate>   Starting sampling rate, 0 < rate <= 1 (default 1).\n");
+    printf("  -s <num>    Most lines sampled at once, 0 for fixed rate (default 8192).\n");
+    printf("  -e          Also compute the exact curve and report the error.\n");
+    printf("  -o <file>   CSV output (default stdout).\n");
+    printf("Example: %s -t big.bin -b 6 -s 16384 -o big.csv\n", argv[0]);
+}
+
+int main(int argc, char *argv[])
+{
+    int c, k, b = -1, exact = 0, last = 0, points = 0;
+    char *trace = NULL, *outname = NULL;
+    double rate = 1, total = 0, err, sum = 0, worst = 0, mr, mx = 0;
+    size_t smax = 8192;
+    uint64_t line, extra;
+    FILE *out = stdout;
+    trace_file_t *tf;
+    trace_rec_t rec;
+    static shards_t sampled, full;
+
+    while ((c = getopt(argc, argv, "ht:b:r:s:eo:")) != -1) {
+        switch (c) {
+        case 't': trace = optarg; break;
+        case 'b': b = atoi(optarg); break;
+        case 'r': rate = atof(optarg); break;
+        case 's': smax = strtoull(optarg, NULL, 0); break;
+        case 'e': exact = 1; break;
+        case 'o': outname = optarg; break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+
+    if (trace == NULL || b < 0) {
+        printf("Error: Missing required argument\n");
+        usage(argv);
+        exit(1);
+    }
+    if (b > 63 || rate <= 0 || rate > 1 || rate * P < 1) {
+        printf("Error: Invalid block bits or sampling rate\n");
+        exit(1);
+    }
+    if ((tf = trace_open(trace)) == NULL) {
+        fprintf(stderr, "Error: could not open %s\n", trace);
+        exit(1);
+    }
+    if (shards_init(&sampled, rate, smax) < 0 ||
+        (exact && shards_init(&full, 1, 0) < 0))
+        goto nomem;
+
+    while (trace_next(tf, &rec)) {
+        if (rec.op == 'I')
+            continue;
+        /* The second half of a modify and folded repeats always hit */
+        line = rec.addr >> b;
+        extra = rec.repeat + (rec.op == 'M');
+        total += 1 + extra;
+        if (shards_access(&sampled, line, extra) < 0 ||
+            (exact && shards_access(&full, line, extra) < 0))
+            goto nomem;
+    }
+    trace_close(tf);
+    /* SHARDS-adj: credit the sampling shortfall (or excess) to hits */
+    sampled.hist[0] += total - sampled.weight;
+
+    if (outname != NULL && (out = fopen(outname, "w")) == NULL) {
+        fprintf(stderr, "Error: could not open %s\n", outname);
+        exit(1);
+    }
+    /* Report up to one bucket past the largest distance seen */
+    for (k = 0; k < NBUCKETS; k++)
+        if (sampled.hist[k] != 0 || (exact && full.hist[k] != 0))
+            last = k;
+    fprintf(out, exact ? "lines,bytes,miss_ratio,exact_miss_ratio\n" : "lines,bytes,miss_ratio\n");
+    for (k = 1; k <= last + 1 && k < NBUCKETS; k++) {
+        mr = miss_ratio(&sampled, k, total);
+        fprintf(out, "%llu,%llu,%.6f", (unsigned long long)bucket_lo(k),
+                (unsigned long long)bucket_lo(k) << b, mr);
+        if (exact) {
+            mx = miss_ratio(&full, k, total);
+            /* Sampled distances come in steps of 1/R; smaller sizes blur */
+            err = mr > mx ? mr - mx : mx - mr;
+            if (bucket_lo(k) * sampled.T >= P) {
+                sum += err;
+                if (err > worst)
+                    worst = err;
+                points++;
+            }
+            fprintf(out, ",%.6f", mx);
+        }
+        fprintf(out, "\n");
+    }
+    if (fclose(out) != 0) {
+        fprintf(stderr, "Error: write failed\n");
+        exit(1);
+    }
+    fprintf(stderr, "%.0f accesses, %zu lines sampled, final rate %.6f\n",
+            total, sampled.lines.count, (double)sampled.T / P);
+    if (exact)
+        fprintf(stderr, "exact: %zu lines; mean abs error %.5f, max %.5f over %d sizes >= %.0f lines\n",
+                full.lines.count, points ? sum / points : 0.0, worst, points,
+                (double)P / sampled.T);
+    shards_free(&sampled);
+    if (exact)
+        shards_free(&full);
+    return 0;
+
+nomem:
+    fprintf(stderr, "Error: out of memory\n");
+    exit(1);
+}
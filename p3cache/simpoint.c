@@ -0,0 +1,410 @@
+/*
+ * simpoint.c - Pick representative intervals of a trace (SimPoint style).
+ *
+ * The trace is cut into intervals of a fixed number of instruction
+ * fetches (I records). Each interval is summarized by how often it
+ * executed each instruction address. These frequency vectors are reduced
+ * with a random projection to a few dimensions and clustered with
+ * k-means for every k up to -k. The smallest k whose BIC score reaches
+ * 90% of the best score wins, as in SimPoint. The interval nearest each
+ * cluster centre stands for the whole cluster, weighted by its share of
+ * the intervals.
+ *
+ * Traces without I records can be sliced by record count with -a; the
+ * vectors then count data lines instead of instruction addresses.
+ *
+ * The output is read by csim -P:
+ *     interval <length> <count> insts|records
+ *     <index> <weight>
+ *     ...
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <stdint.h>
+#include "trace.h"
+#include "lineset.h"
+
+/* Give up on a k-means run that has not settled after this many rounds */
+#define MAX_ROUNDS 100
+
+/* A data line, used for the vectors of -a */
+#define LINE_BITS 6
+
+typedef struct sp_state {
+    int dims;
+    uint64_t rng;
+
+    /* Projection: one row of dims values per distinct address */
+    lineset_t rows;
+    double *proj;
+    uint32_t nrows, arows;
+
+    /* One projected vector per interval */
+    double *vecs;
+    uint64_t nint, aint;
+} sp_state;
+
+static inline uint64_t xorshift(sp_state *g)
+{
+    uint64_t x = g->rng;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    g->rng = x;
+    return x;
+}
+
+/* Uniform in [0, 1) */
+static inline double uniform(sp_state *g)
+{
+    return (xorshift(g) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * project_row - Return the projection row of addr, drawing a new one
+ *     from [-1, 1) the first time addr is seen
+ */
+static double *project_row(sp_state *g, uint64_t addr)
+{
+    int added, j;
+    uint32_t *slot = lineset_insert(&g->rows, addr, &added);
+
+    if (slot == NULL)
+        return NULL;
+    if (added) {
+        if (g->nrows == g->arows) {
+            g->arows = g->arows ? g->arows * 2 : 1024;
+            g->proj = (double*)realloc(g->proj, sizeof(double) * g->arows * g->dims);
+            if (g->proj == NULL)
+                return NULL;
+        }
+        *slot = g->nrows++;
+        for (j = 0; j < g->dims; j++)
+            g->proj[(size_t)*slot * g->dims + j] = 2.0 * uniform(g) - 1.0;
+    }
+    return &g->proj[(size_t)*slot * g->dims];
+}
+
+/*
+ * new_interval - Append a zeroed vector for the next interval
+ */
+static double *new_interval(sp_state *g)
+{
+    if (g->nint == g->aint) {
+        g->aint = g->aint ? g->aint * 2 : 256;
+        g->vecs = (double*)realloc(g->vecs, sizeof(double) * g->aint * g->dims);
+        if (g->vecs == NULL)
+            return NULL;
+    }
+    memset(&g->vecs[g->nint * g->dims], 0, sizeof(double) * g->dims);
+    return &g->vecs[g->nint++ * g->dims];
+}
+
+/*
+ * scale - Normalize an interval's vector by the number of accesses in it
+ */
+static void scale(double *v, int dims, uint64_t n)
+{
+    int j;
+    for (j = 0; j < dims && n; j++)
+        v[j] /= n;
+}
+
+static double dist2(const double *a, const double *b, int dims)
+{
+    double d = 0, t;
+    int j;
+    for (j = 0; j < dims; j++) {
+        t = a[j] - b[j];
+        d += t * t;
+    }
+    return d;
+}
+
+/*
+ * kmeans - Cluster the intervals into k groups, seeding with k-means++.
+ *     Fills assign and cent and returns the sum of squared distances.
+ */
+static double kmeans(sp_state *g, int k, int *assign, double *cent, double *best)
+{
+    uint64_t i, n = g->nint;
+    int c, j, d = g->dims, round, changed = 1;
+    int *size = (int*)calloc(k, sizeof(int));
+    double sse = 0, sum, r;
+
+    /* k-means++: each further seed is drawn in proportion to its distance */
+    i = xorshift(g) % n;
+    memcpy(cent, &g->vecs[i * d], sizeof(double) * d);
+    for (i = 0; i < n; i++)
+        best[i] = dist2(&g->vecs[i * d], cent, d);
+    for (c = 1; c < k; c++) {
+        for (sum = 0, i = 0; i < n; i++)
+            sum += best[i];
+        r = uniform(g) * sum;
+        for (i = 0; i + 1 < n && r >= best[i]; i++)
+            r -= best[i];
+        memcpy(&cent[c * d], &g->vecs[i * d], sizeof(double) * d);
+        for (i = 0; i < n; i++) {
+            double t = dist2(&g->vecs[i * d], &cent[c * d], d);
+            if (t < best[i])
+                best[i] = t;
+        }
+    }
+
+    for (i = 0; i < n; i++)
+        assign[i] = -1;
+    for (round = 0; round < MAX_ROUNDS && changed; round++) {
+        changed = 0;
+        for (i = 0; i < n; i++) {
+            int pick = 0;
+            double bd = dist2(&g->vecs[i * d], cent, d), t;
+            for (c = 1; c < k; c++) {
+                t = dist2(&g->vecs[i * d], &cent[c * d], d);
+                if (t < bd) {
+                    bd = t;
+                    pick = c;
+                }
+            }
+            if (assign[i] != pick) {
+                assign[i] = pick;
+                changed = 1;
+            }
+        }
+        /* Move each centre to the mean of its members; empty ones stay */
+        memset(size, 0, sizeof(int) * k);
+        for (i = 0; i < n; i++)
+            size[assign[i]]++;
+        for (c = 0; c < k; c++)
+            if (size[c])
+                memset(&cent[c * d], 0, sizeof(double) * d);
+        for (i = 0; i < n; i++)
+            for (j = 0; j < d; j++)
+                cent[assign[i] * d + j] += g->vecs[i * d + j];
+        for (c = 0; c < k; c++)
+            for (j = 0; j < d && size[c]; j++)
+                cent[c * d + j] /= size[c];
+    }
+
+    for (i = 0; i < n; i++)
+        sse += dist2(&g->vecs[i * d], &cent[assign[i] * d], d);
+    free(size);
+    return sse;
+}
+
+/*
+ * bic - Bayesian information criterion of a clustering, with the
+ *     spherical Gaussian model of X-means (Pelleg and Moore)
+ */
+static double bic(const int *assign, uint64_t n, int k, int dims, double sse)
+{
+    int c, *size = (int*)calloc(k, sizeof(int));
+    double var, ll = 0, params = (k - 1) + (double)dims * k + 1;
+    uint64_t i;
+
+    for (i = 0; i < n; i++)
+        size[assign[i]]++;
+    var = n > (uint64_t)k ? sse / (n - k) : 0;
+    if (var < 1e-12)
+        var = 1e-12;
+    for (c = 0; c < k; c++) {
+        double rn = size[c];
+        if (rn == 0)
+            continue;
+        ll += -rn / 2 * log(2 * M_PI) - rn * dims / 2 * log(var) - (rn - k) / 2 +
+            rn * log(rn) - rn * log((double)n);
+    }
+    free(size);
+    return ll - params / 2 * log((double)n);
+}
+
+/*
+ * usage - Print usage info
+ */
+void usage(char *argv[])
+{
+    printf("Usage: %s [-hav] -t <file> [-i <num>] [-k <num>] [-d <num>] [-n <num>] [-s <seed>] [-o <file>]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h          Print this help message.\n");
+    printf("  -v          Print the BIC score of every k to stderr.\n");
+    printf("  -t <file>   Trace to sample (text or binary).\n");
+    printf("  -i <num>    Interval length in instructions (default 100000).\n");
+    printf("  -a          Count all records, not instructions, and cluster on data lines.\n");
+    printf("  -k <num>    Most clusters to try (default 10).\n");
+    printf("  -d <num>    Projected dimensions (default 15).\n");
+    printf("  -n <num>    k-means restarts for each k (default 5).\n");
+    printf("  -s <seed>   Random seed (default 1).\n");
+    printf("  -o <file>   Output file (default stdout).\n");
+    printf("Example: %s -t big.bin -i 1000000 -o big.sp; csim -s 8 -E 4 -b 6 -t big.bin -P big.sp\n", argv[0]);
+}
+
+int main(int argc, char *argv[])
+{
+    int c, k, r, j, kmax = 10, restarts = 5, all = 0, verbose = 0, bestk = 1, points = 0;
+    char *trace = NULL, *outname = NULL;
+    uint64_t length = 100000, seed = 1, count = 0, i, *size, *rep;
+    FILE *out = stdout;
+    trace_file_t *tf;
+    trace_rec_t rec;
+    sp_state g;
+    double *v = NULL, *row, *scores, *cent, *best, lo, hi;
+    int *assign, *trial;
+
+    memset(&g, 0, sizeof(g));
+    g.dims = 15;
+    while ((c = getopt(argc, argv, "hvt:i:ak:d:n:s:o:")) != -1) {
+        switch (c) {
+        case 't': trace = optarg; break;
+        case 'i': length = strtoull(optarg, NULL, 0); break;
+        case 'a': all = 1; break;
+        case 'k': kmax = atoi(optarg); break;
+        case 'd': g.dims = atoi(optarg); break;
+        case 'n': restarts = atoi(optarg); break;
+        case 's': seed = strtoull(optarg, NULL, 0); break;
+        case 'o': outname = optarg; break;
+        case 'v': verbose = 1; break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+
+    if (trace == NULL) {
+        printf("Error: Missing required argument\n");
+        usage(argv);
+        exit(1);
+    }
+    if (length == 0 || kmax < 1 || g.dims < 1 || restarts < 1) {
+        printf("Error: Invalid interval length, cluster count, dimensions or restarts\n");
+        exit(1);
+    }
+    if ((tf = trace_open(trace)) == NULL) {
+        fprintf(stderr, "Error: could not open %s\n", trace);
+        exit(1);
+    }
+
+    /* xorshift must never be seeded with zero */
+    g.rng = seed * 0x9E3779B97F4A7C15ULL + 0x2545F4914F6CDD1DULL;
+    if (g.rng == 0)
+        g.rng = 1;
+    if (lineset_init(&g.rows, 1024) < 0)
+        goto nomem;
+
+    /* Build one projected frequency vector per interval */
+    while (trace_next(tf, &rec)) {
+        if (!all && rec.op != 'I')
+            continue;
+        if (count % length == 0) {
+            if (v != NULL)
+                scale(v, g.dims, length);
+            if ((v = new_interval(&g)) == NULL)
+                goto nomem;
+        }
+        count++;
+        row = project_row(&g, all ? rec.addr >> LINE_BITS : rec.addr);
+        if (row == NULL)
+            goto nomem;
+        for (j = 0; j < g.dims; j++)
+            v[j] += row[j];
+    }
+    trace_close(tf);
+    if (g.nint == 0) {
+        fprintf(stderr, "Error: %s has no %s\n", trace, all ? "records" : "I records (try -a)");
+        exit(1);
+    }
+    scale(v, g.dims, count - (g.nint - 1) * length);
+    if ((uint64_t)kmax > g.nint)
+        kmax = g.nint;
+
+    /* Keep the best of several seeded runs for every k */
+    scores = (double*)malloc(sizeof(double) * (kmax + 1));
+    assign = (int*)malloc(sizeof(int) * g.nint * (kmax + 1));
+    trial = (int*)malloc(sizeof(int) * g.nint);
+    best = (double*)malloc(sizeof(double) * g.nint);
+    cent = (double*)malloc(sizeof(double) * kmax * g.dims);
+    if (scores == NULL || assign == NULL || trial == NULL || best == NULL || cent == NULL)
+        goto nomem;
+    for (k = 1; k <= kmax; k++) {
+        double least = HUGE_VAL, sse;
+        for (r = 0; r < restarts; r++) {
+            sse = kmeans(&g, k, trial, cent, best);
+            if (sse < least) {
+                least = sse;
+                memcpy(&assign[g.nint * k], trial, sizeof(int) * g.nint);
+            }
+        }
+        scores[k] = bic(&assign[g.nint * k], g.nint, k, g.dims, least);
+    }
+    for (lo = hi = scores[1], k = 2; k <= kmax; k++) {
+        if (scores[k] < lo)
+            lo = scores[k];
+        if (scores[k] > hi)
+            hi = scores[k];
+    }
+    for (k = 1; k <= kmax; k++) {
+        if (verbose)
+            fprintf(stderr, "k=%d bic=%.2f\n", k, scores[k]);
+        if (scores[k] >= lo + 0.9 * (hi - lo)) {
+            bestk = k;
+            break;
+        }
+    }
+    while (verbose && ++k <= kmax)
+        fprintf(stderr, "k=%d bic=%.2f\n", k, scores[k]);
+
+    /* The member nearest each centre represents its cluster */
+    assign = &assign[g.nint * bestk];
+    size = (uint64_t*)calloc(bestk, sizeof(uint64_t));
+    rep = (uint64_t*)malloc(sizeof(uint64_t) * bestk);
+    if (size == NULL || rep == NULL)
+        goto nomem;
+    memset(cent, 0, sizeof(double) * bestk * g.dims);
+    for (i = 0; i < g.nint; i++) {
+        size[assign[i]]++;
+        for (j = 0; j < g.dims; j++)
+            cent[assign[i] * g.dims + j] += g.vecs[i * g.dims + j];
+    }
+    for (c = 0; c < bestk; c++) {
+        for (j = 0; j < g.dims && size[c]; j++)
+            cent[c * g.dims + j] /= size[c];
+        best[c] = HUGE_VAL;
+    }
+    for (i = 0; i < g.nint; i++) {
+        double d = dist2(&g.vecs[i * g.dims], &cent[assign[i] * g.dims], g.dims);
+        if (d < best[assign[i]]) {
+            best[assign[i]] = d;
+            rep[assign[i]] = i;
+        }
+    }
+
+    if (outname != NULL && (out = fopen(outname, "w")) == NULL) {
+        fprintf(stderr, "Error: could not open %s\n", outname);
+        exit(1);
+    }
+    fprintf(out, "interval %llu %llu %s\n", (unsigned long long)length,
+            (unsigned long long)g.nint, all ? "records" : "insts");
+    /* Chosen intervals in trace order */
+    for (i = 0; i < g.nint; i++)
+        for (c = 0; c < bestk; c++)
+            if (size[c] && rep[c] == i) {
+                fprintf(out, "%llu %.6f\n", (unsigned long long)i, (double)size[c] / g.nint);
+                points++;
+            }
+    if (fclose(out) != 0) {
+        fprintf(stderr, "Error: write failed\n");
+        exit(1);
+    }
+    fprintf(stderr, "%llu intervals, %d simulation points\n", (unsigned long long)g.nint, points);
+    return 0;
+
+nomem:
+    fprintf(stderr, "Error: out of memory\n");
+    exit(1);
+}
@@ -0,0 +1,456 @@
+/*
+ * synthgen.c - Native generator for synthetic memory traces.
+ *
+ * Unlike tracegen, which needs valgrind to record the transpose
+ * functions, synthgen computes address streams directly from simple
+ * workload models and writes them as lackey text or as binary traces
+ * (see trace.h). Every model is driven by a seeded xorshift generator,
+ * so the same command line always reproduces the same trace.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <stdint.h>
+#include "trace.h"
+
+/* Records generated per batch before they are written out */
+#define BATCH 8192
+
+/* Size of a cache line, used as the pointer-chasing node size */
+#define LINE 64
+
+typedef struct gen_state {
+    /* Parameters from the command line */
+    uint64_t base;
+    uint64_t footprint;
+    uint32_t elem;
+    uint64_t stride;
+    double write_frac;
+    double theta;
+    uint64_t tile;
+
+    /* Generator state */
+    uint64_t rng;
+    uint64_t write_thresh;
+    uint64_t nelem;
+    uint64_t i;
+
+    /* zipf */
+    double zeta_n, alpha, eta, zeta2;
+
+    /* pointer chasing; half_bits and keys also scatter zipf ranks */
+    uint64_t nlines;
+    int half_bits;
+    uint64_t keys[4];
+
+    /* stencil and gemm loop nest */
+    uint64_t dim;
+    uint64_t ii, jj, kk, x, y, z;
+    int phase;
+} gen_state;
+
+typedef void (*gen_fn)(gen_state *g, trace_rec_t *out);
+
+static inline uint64_t xorshift(gen_state *g)
+{
+    uint64_t x = g->rng;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    g->rng = x;
+    return x;
+}
+
+/* Pick L or S according to the requested read/write mix */
+static inline char pick_op(gen_state *g)
+{
+    if (g->write_thresh == 0)
+        return 'L';
+    return (xorshift(g) >> 11) < g->write_thresh ? 'S' : 'L';
+}
+
+static inline void emit(trace_rec_t *out, char op, uint64_t addr, uint32_t size)
+{
+    memset(out, 0, sizeof(*out));
+    out->addr = addr;
+    out->size = size;
+    out->op = op;
+}
+
+/*
+ * gen_seq - Unit-stride walk over the footprint
+ */
+static void gen_seq(gen_state *g, trace_rec_t *out)
+{
+    emit(out, pick_op(g), g->base + (g->i % g->nelem) * g->elem, g->elem);
+    g->i++;
+}
+
+/*
+ * gen_stride - Fixed-stride walk; each pass over the footprint starts one
+ *     element further along so that every element is eventually touched
+ */
+static void gen_stride(gen_state *g, trace_rec_t *out)
+{
+    emit(out, pick_op(g), g->base + g->x, g->elem);
+    g->x += g->stride;
+    if (g->x + g->elem > g->footprint) {
+        g->y = (g->y + g->elem) % g->stride;
+        g->x = g->y;
+    }
+}
+
+/*
+ * gen_uniform - Independent uniformly random elements
+ */
+static void gen_uniform(gen_state *g, trace_rec_t *out)
+{
+    emit(out, pick_op(g), g->base + (xorshift(g) % g->nelem) * g->elem, g->elem);
+}
+
+/*
+ * permute - Keyed bijection on [0, n): a 4-round Feistel network on
+ *     2*half_bits bits (set up by setup_permute for n), cycle-walking
+ *     until the result is in range
+ */
+static uint64_t permute(gen_state *g, uint64_t v, uint64_t n)
+{
+    uint64_t mask = (1ULL << g->half_bits) - 1;
+    uint64_t l, r, t;
+    int k;
+
+    do {
+        l = v >> g->half_bits;
+        r = v & mask;
+        for (k = 0; k < 4; k++) {
+            t = r;
+            r = l ^ (((r * g->keys[k]) >> 7 ^ r) & mask);
+            l = t;
+        }
+        v = (l << g->half_bits) | r;
+    } while (v >= n);
+    return v;
+}
+
+/*
+ * gen_zipf - Zipfian element popularity (Gray et al., "Quickly generating
+ *     billion-record synthetic databases"). Ranks are scattered over the
+ *     footprint with permute, a bijection, so hot elements are not all
+ *     adjacent and every element keeps its own rank.
+ */
+static void gen_zipf(gen_state *g, trace_rec_t *out)
+{
+    double u = (xorshift(g) >> 11) * (1.0 / 9007199254740992.0);
+    double uz = u * g->zeta_n;
+    uint64_t rank;
+
+    if (uz < 1.0)
+        rank = 0;
+    else if (uz < g->zeta2)
+        rank = 1;
+    else
+        rank = (uint64_t)(g->nelem * pow(g->eta * u - g->eta + 1, g->alpha));
+    if (rank >= g->nelem)
+        rank = g->nelem - 1;
+    rank = permute(g, rank, g->nelem);
+    emit(out, pick_op(g), g->base + rank * g->elem, g->elem);
+}
+
+/*
+ * gen_chase - Follow a single random cycle through every line of the
+ *     footprint, as a linked-list traversal would. Visiting the lines in
+ *     the order permute(0), permute(1), ... is exactly such a cycle, and
+ *     needs no next-pointer table.
+ */
+static void gen_chase(gen_state *g, trace_rec_t *out)
+{
+    emit(out, pick_op(g), g->base + permute(g, g->i, g->nlines) * LINE, 8);
+    if (++g->i == g->nlines)
+        g->i = 0;
+}
+
+/*
+ * gen_stencil - 5-point Jacobi sweeps over two dim x dim grids, reading
+ *     the four neighbours and centre of in[y][x] and writing out[y][x].
+ *     The grids swap roles after every sweep.
+ */
+static void gen_stencil(gen_state *g, trace_rec_t *out)
+{
+    static const int dy[] = {-1, 0, 0, 0, 1};
+    static const int dx[] = {0, -1, 0, 1, 0};
+    uint64_t grid = g->dim * g->dim * g->elem;
+    uint64_t in = g->base + (g->z & 1) * grid;
+    uint64_t dst = g->base + ((g->z + 1) & 1) * grid;
+
+    if (g->phase < 5) {
+        uint64_t idx = (g->y + dy[g->phase]) * g->dim + g->x + dx[g->phase];
+        emit(out, 'L', in + idx * g->elem, g->elem);
+        g->phase++;
+        return;
+    }
+    emit(out, 'S', dst + (g->y * g->dim + g->x) * g->elem, g->elem);
+    g->phase = 0;
+    if (++g->x == g->dim - 1) {
+        g->x = 1;
+        if (++g->y == g->dim - 1) {
+            g->y = 1;
+            g->z++;
+        }
+    }
+}
+
+/*
+ * gen_gemm - Tiled C += A * B on dim x dim matrices with (ii, jj, kk)
+ *     tile loops around an (i, k, j) micro-kernel: A[i][k] is loaded once
+ *     per k, then B[k][j] is loaded and C[i][j] modified for every j
+ */
+static void gen_gemm(gen_state *g, trace_rec_t *out)
+{
+    uint64_t mat = g->dim * g->dim * g->elem;
+    uint64_t A = g->base, B = A + mat, C = B + mat;
+    uint64_t T = g->tile, n = g->dim;
+    uint64_t jmax = g->jj + T < n ? g->jj + T : n;
+
+    if (g->phase == 0) {
+        emit(out, 'L', A + (g->x * n + g->y) * g->elem, g->elem);
+        g->phase = 1;
+        return;
+    }
+    if (g->phase == 1) {
+        emit(out, 'L', B + (g->y * n + g->z) * g->elem, g->elem);
+        g->phase = 2;
+        return;
+    }
+    emit(out, 'M', C + (g->x * n + g->z) * g->elem, g->elem);
+
+    /* Advance j, then k, then i, then the kk, jj, ii tiles */
+    g->phase = 1;
+    if (++g->z < jmax)
+        return;
+    g->z = g->jj;
+    g->phase = 0;
+    if (++g->y < (g->kk + T < n ? g->kk + T : n))
+        return;
+    g->y = g->kk;
+    if (++g->x < (g->ii + T < n ? g->ii + T : n))
+        return;
+    g->x = g->ii;
+    if ((g->kk += T) >= n) {
+        g->kk = 0;
+        if ((g->jj += T) >= n) {
+            g->jj = 0;
+            if ((g->ii += T) >= n)
+                g->ii = 0;
+        }
+    }
+    g->x = g->ii;
+    g->y = g->kk;
+    g->z = g->jj;
+}
+
+/*
+ * setup_permute - Pick the Feistel width and keys for permute over [0, n)
+ */
+static void setup_permute(gen_state *g, uint64_t n)
+{
+    int bits;
+    int k;
+
+    for (bits = 1; (1ULL << (2 * bits)) < n; bits++)
+        ;
+    g->half_bits = bits;
+    for (k = 0; k < 4; k++)
+        g->keys[k] = xorshift(g) | 1;
+}
+
+/*
+ * setup - Derive per-model state from the parameters; returns the
+ *     generator for the model or NULL if the model is unknown
+ */
+static gen_fn setup(gen_state *g, const char *model)
+{
+    uint64_t i;
+
+    g->nelem = g->footprint / g->elem;
+    if (g->nelem == 0)
+        g->nelem = 1;
+    g->write_thresh = (uint64_t)(g->write_frac * 9007199254740992.0);
+
+    if (strcmp(model, "seq") == 0)
+        return gen_seq;
+    if (strcmp(model, "stride") == 0) {
+        if (g->stride == 0)
+            g->stride = LINE;
+        return gen_stride;
+    }
+    if (strcmp(model, "uniform") == 0)
+        return gen_uniform;
+    if (strcmp(model, "zipf") == 0) {
+        for (i = 1; i <= g->nelem; i++)
+            g->zeta_n += 1.0 / pow((double)i, g->theta);
+        g->zeta2 = 1.0 + pow(0.5, g->theta);
+        g->alpha = 1.0 / (1.0 - g->theta);
+        g->eta = (1 - pow(2.0 / g->nelem, 1 - g->theta)) / (1 - g->zeta2 / g->zeta_n);
+        setup_permute(g, g->nelem);
+        return gen_zipf;
+    }
+    if (strcmp(model, "chase") == 0) {
+        g->nlines = g->footprint / LINE;
+        if (g->nlines < 2)
+            g->nlines = 2;
+        setup_permute(g, g->nlines);
+        return gen_chase;
+    }
+    if (strcmp(model, "stencil") == 0) {
+        g->dim = (uint64_t)sqrt((double)g->footprint / (2.0 * g->elem));
+        if (g->dim < 3)
+            g->dim = 3;
+        g->x = g->y = 1;
+        return gen_stencil;
+    }
+    if (strcmp(model, "gemm") == 0) {
+        g->dim = (uint64_t)sqrt((double)g->footprint / (3.0 * g->elem));
+        if (g->dim < 1)
+            g->dim = 1;
+        if (g->tile == 0)
+            g->tile = 32;
+        return gen_gemm;
+    }
+    return NULL;
+}
+
+/*
+ * parse_size - Parse a byte count with an optional K, M or G suffix
+ */
+static uint64_t parse_size(const char *s)
+{
+    char *end;
+    uint64_t v = strtoull(s, &end, 0);
+    switch (*end) {
+    case 'k': case 'K': return v << 10;
+    case 'm': case 'M': return v << 20;
+    case 'g': case 'G': return v << 30;
+    }
+    return v;
+}
+
+/*
+ * usage - Print usage info
+ */
+void usage(char *argv[])
+{
+    printf("Usage: %s [-hB] -m <model> -n <num> [-f <bytes>] [options]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h          Print this help message.\n");
+    printf("  -m <model>  seq, stride, uniform, zipf, chase, stencil or gemm.\n");
+    printf("  -n <num>    Number of records to generate.\n");
+    printf("  -f <bytes>  Footprint; K, M and G suffixes accepted (default 1M).\n");
+    printf("  -e <bytes>  Element size (default 8).\n");
+    printf("  -w <frac>   Fraction of stores for seq/stride/uniform/zipf/chase (default 0).\n");
+    printf("  -d <bytes>  Stride for the stride model (default %d).\n", LINE);
+    printf("  -z <theta>  Skew for the zipf model, 0 < theta < 1 (default 0.99).\n");
+    printf("  -T <num>    Tile edge for the gemm model (default 32).\n");
+    printf("  -a <addr>   Base address (default 0x10000000).\n");
+    printf("  -s <seed>   Random seed (default 1).\n");
+    printf("  -B          Write a binary trace instead of lackey text.\n");
+    printf("  -o <file>   Output file (default stdout).\n");
+    printf("Example: %s -m zipf -n 100000000 -f 64M -w 0.3 -B -o zipf.bin\n", argv[0]);
+}
+
+int main(int argc, char *argv[])
+{
+    int c, binary = 0;
+    uint64_t count = 0, done, k, seed = 1;
+    char *model = NULL, *outname = NULL;
+    FILE *out = stdout;
+    gen_state g;
+    gen_fn gen;
+    static trace_rec_t recs[BATCH];
+    static char text[BATCH * 32];
+
+    memset(&g, 0, sizeof(g));
+    g.base = 0x10000000;
+    g.footprint = 1 << 20;
+    g.elem = 8;
+    g.theta = 0.99;
+
+    while ((c = getopt(argc, argv, "hm:n:f:e:w:d:z:T:a:s:Bo:")) != -1) {
+        switch (c) {
+        case 'm': model = optarg; break;
+        case 'n': count = strtoull(optarg, NULL, 0); break;
+        case 'f': g.footprint = parse_size(optarg); break;
+        case 'e': g.elem = atoi(optarg); break;
+        case 'w': g.write_frac = atof(optarg); break;
+        case 'd': g.stride = parse_size(optarg); break;
+        case 'z': g.theta = atof(optarg); break;
+        case 'T': g.tile = strtoull(optarg, NULL, 0); break;
+        case 'a': g.base = strtoull(optarg, NULL, 0); break;
+        case 's': seed = strtoull(optarg, NULL, 0); break;
+        case 'B': binary = 1; break;
+        case 'o': outname = optarg; break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+
+    if (model == NULL || count == 0) {
+        printf("Error: Missing required argument\n");
+        usage(argv);
+        exit(1);
+    }
+    if (g.elem == 0 || g.theta <= 0 || g.theta >= 1 ||
+        g.write_frac < 0 || g.write_frac > 1) {
+        printf("Error: Invalid element size, skew or write fraction\n");
+        exit(1);
+    }
+
+    /* xorshift must never be seeded with zero */
+    g.rng = seed * 0x9E3779B97F4A7C15ULL + 0x2545F4914F6CDD1DULL;
+    if (g.rng == 0)
+        g.rng = 1;
+
+    gen = setup(&g, model);
+    if (gen == NULL) {
+        printf("Error: Unknown model %s\n", model);
+        exit(1);
+    }
+
+    if (outname != NULL && (out = fopen(outname, "w")) == NULL) {
+        fprintf(stderr, "Error: could not open %s\n", outname);
+        exit(1);
+    }
+    setvbuf(out, NULL, _IOFBF, 1 << 20);
+    if (binary && trace_write_header(out) < 0) {
+        fprintf(stderr, "Error: write failed\n");
+        exit(1);
+    }
+
+    for (done = 0; done < count; done += k) {
+        uint64_t n = count - done < BATCH ? count - done : BATCH;
+        for (k = 0; k < n; k++)
+            gen(&g, &recs[k]);
+        if (binary) {
+            if (fwrite(recs, sizeof(trace_rec_t), n, out) != n)
+                break;
+        } else {
+            size_t len = 0;
+            for (k = 0; k < n; k++)
+                len += trace_format(text + len, &recs[k]);
+            if (fwrite(text, 1, len, out) != len)
+                break;
+        }
+    }
+
+    if (fclose(out) != 0 || done < count) {
+        fprintf(stderr, "Error: write failed\n");
+        exit(1);
+    }
+    return 0;
+}
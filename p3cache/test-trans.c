@@ -3,6 +3,7 @@
  *     student's transpose functions and records the results for their
  *     official submitted version as well.
  */
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -14,6 +15,9 @@
 #include "cachelab.h"
 #include <sys/wait.h> // for WEXITSTATUS
 #include <limits.h> // for INT_MAX
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 
 /* Maximum array dimension */
 #define MAXN 256
@@ -28,10 +32,23 @@ extern void registerFunctions();
 /* External variables defined in cachelab-tools.c */
 extern trans_func_t func_list[MAX_TRANS_FUNCS];
 extern int func_counter;
+extern trans_gfunc_t gfunc_list[MAX_TRANS_GFUNCS];
+extern int gfunc_counter;
+
+/* Functions are numbered as tracegen numbers them: the int ones, then
+   those of other element types */
+#define MAX_FUNCS (MAX_TRANS_FUNCS + MAX_TRANS_GFUNCS)
+
+/* Seconds before giving up: a base for starting up, and more for each
+   registered function, whatever the number of workers */
+#define TIMEOUT_BASE 120
+#define TIMEOUT_PER_FUNC 15
 
 /* Globals set on the command line */
 static int M = 0;
 static int N = 0;
+static int native = 0;  /* trace with tracegen-native instead of valgrind */
+static int workers = 0; /* functions evaluated at once; 0 for one per CPU */
 
 /* The correctness and performance for the submitted transpose function */
 struct results {
@@ -41,134 +58,353 @@ struct results {
 };
 static struct results results = {-1, 0, INT_MAX};
 
+/* Outcome of evaluating one function, written by its worker process */
+struct func_result {
+    int correct;
+    unsigned int hits, misses, evictions;
+};
+
+/* A worker process and the output it has sent so far */
+struct worker {
+    pid_t pid;
+    int fd;             /* read end of the worker's stdout, -1 once closed */
+    char *out;
+    size_t len;
+};
+
 /*
- * eval_perf - Evaluate the performance of the registered transpose functions
+ * func_desc - Description of function i
  */
-void eval_perf(unsigned int s, unsigned int E, unsigned int b)
+static char *func_desc(int i)
 {
-    int i,flag;
-    unsigned int len, hits, misses, evictions;
-    unsigned long long int marker_start, marker_end, addr;
-    char buf[1000], cmd[255];
-    char filename[128], tmpname[512];
+    return i < func_counter ? func_list[i].description
+                            : gfunc_list[i - func_counter].description;
+}
 
-    registerFunctions();
+/*
+ * run_cmd - Run argv (looked up in PATH) in directory dir, or the current
+ *     one if dir is NULL, with stdout going to the file out, or unchanged
+ *     if out is NULL. Returns the exit status as the shell would: 127 if
+ *     it could not be run, 128 plus the signal if one killed it.
+ */
+static int run_cmd(char *const argv[], const char *dir, const char *out)
+{
+    pid_t pid;
+    int fd, status;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0)
+        return 127;
+    if (pid == 0) {
+        if (dir != NULL && chdir(dir) < 0)
+            _exit(127);
+        if (out != NULL) {
+            if ((fd = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+                _exit(127);
+            dup2(fd, STDOUT_FILENO);
+            close(fd);
+        }
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+    if (waitpid(pid, &status, 0) < 0)
+        return 127;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+/*
+ * eval_func - Validate function i, trace it and simulate the trace. Runs
+ *     in a worker process; the valgrind output, the marker file and
+ *     .csim_results go to the scratch directory dir, so that workers do
+ *     not overwrite each other's files.
+ */
+void eval_func(int i, unsigned int s, unsigned int E, unsigned int b,
+               const char *dir, const char *cwd, struct func_result *r)
+{
+    int flag;
+    unsigned int len;
+    unsigned long long int marker_start, marker_end, addr;
+    char buf[1000], Ms[16], Ns[16], Fs[16], ss[16], Es[16], bs[16];
+    char filename[128], tmpname[512], markername[512], resultname[512];
+    char sim[PATH_MAX + 32], trace[PATH_MAX + 32];
 
     /* Open the complete trace file */
     FILE* full_trace_fp;
     FILE* part_trace_fp;
 
-    /* Evaluate the performance of each registered transpose function */
+    sprintf(tmpname, "%s/trace.tmp", dir);
+    sprintf(markername, "%s/marker", dir);
+    sprintf(resultname, "%s/.csim_results", dir);
+    sprintf(Ms, "%d", M);
+    sprintf(Ns, "%d", N);
+    sprintf(Fs, "%d", i);
+    sprintf(ss, "%u", s);
+    sprintf(Es, "%u", E);
+    sprintf(bs, "%u", b);
+
+    printf("\nFunction %d (%d total)\nStep 1: Validating and generating memory traces\n",i,func_counter+gfunc_counter);
+
+    /* The native build records and filters its own trace */
+    if (native) {
+        char *argv[] = {"./tracegen-native", "-M", Ms, "-N", Ns, "-F", Fs,
+                        "-m", markername, "-o", filename, NULL};
+        sprintf(filename, "trace.f%d", i);
+        flag = run_cmd(argv, NULL, NULL);
+        if (0!=flag) {
+            printf("Validation error at function %d! Run ./tracegen -M %d -N %d -F %d for details.\nSkipping performance evaluation for this function.\n",flag-1,M,N,i);
+            return;
+        }
+        r->correct = 1;
+        goto simulate;
+    }
 
-    for (i=0; i<func_counter; i++) {
-        if (strcmp(func_list[i].description, SUBMIT_DESCRIPTION) == 0 )
-            results.funcid = i; /* remember which function is the submission */
+    /* Use valgrind to generate the trace */
+    char *argv[] = {"valgrind", "--tool=lackey", "--trace-mem=yes", "--log-fd=1",
+                    "-v", "./tracegen", "-M", Ms, "-N", Ns, "-F", Fs,
+                    "-m", markername, NULL};
+    flag = run_cmd(argv, NULL, tmpname);
+    if (0!=flag) {
+        printf("Validation error at function %d! Run ./tracegen -M %d -N %d -F %d for details.\nSkipping performance evaluation for this function.\n",flag-1,M,N,i);
+        return;
+    }
 
+    /* Get the start and end marker addresses */
+    FILE* marker_fp = fopen(markername, "r");
+    assert(marker_fp);
+    fscanf(marker_fp, "%llx %llx", &marker_start, &marker_end);
+    fclose(marker_fp);
+
+    r->correct = 1;
+
+    full_trace_fp = fopen(tmpname, "r");
+    assert(full_trace_fp);
+
+    /* Filtered trace for each transpose function goes in a separate file */
+    sprintf(filename, "trace.f%d", i);
+    part_trace_fp = fopen(filename, "w");
+    assert(part_trace_fp);
+
+    /* Locate trace corresponding to the trans function */
+    flag = 0;
+    while (fgets(buf, 1000, full_trace_fp) != NULL) {
+
+        /* We are only interested in memory access instructions */
+        if (buf[0]==' ' && buf[2]==' ' &&
+            (buf[1]=='S' || buf[1]=='M' || buf[1]=='L' )) {
+            sscanf(buf+3, "%llx,%u", &addr, &len);
+
+            /* If start marker found, set flag */
+            if (addr == marker_start)
+                flag = 1;
+
+            /* Valgrind creates many spurious accesses to the
+               stack that have nothing to do with the students
+               code. At the moment, we are ignoring all stack
+               accesses by using the simple filter of recording
+               accesses to only the low 32-bit portion of the
+               address space. At some point it would be nice to
+               try to do more informed filtering so that would
+               eliminate the valgrind stack references while
+               include the student stack references. */
+            if (flag && addr < 0xffffffff) {
+                fputs(buf, part_trace_fp);
+            }
 
-        printf("\nFunction %d (%d total)\nStep 1: Validating and generating memory traces\n",i,func_counter);
-        /* Use valgrind to generate the trace */
+            /* if end marker found, close trace file */
+            if (addr == marker_end) {
+                flag = 0;
+                fclose(part_trace_fp);
+                break;
+            }
+        }
+    }
+    fclose(full_trace_fp);
+
+simulate:
+    /* Run the reference simulator, or ask a csim server if one is up. It
+       runs in dir so that its .csim_results is this worker's own. */
+    printf("Step 2: Evaluating performance (s=%d, E=%d, b=%d)\n", s, E, b);
+    if (snprintf(sim, sizeof(sim), "%s/%s", cwd,
+                 getenv("CSIM_SERVER") ? "csim-client" : "csim-ref") >= (int)sizeof(sim) ||
+        snprintf(trace, sizeof(trace), "%s/trace.f%d", cwd, i) >= (int)sizeof(trace)) {
+        printf("Error: path too long: %s\n", cwd);
+        r->correct = 0;
+        return;
+    }
+    char *sim_argv[] = {sim, "-s", ss, "-E", Es, "-b", bs, "-t", trace, NULL};
+    flag = run_cmd(sim_argv, dir, "/dev/null");
+
+    /* Collect results from the reference simulator; a failed run is not
+       scored, rather than scored from a stale or partial file */
+    FILE* in_fp = flag == 0 ? fopen(resultname,"r") : NULL;
+    if (in_fp == NULL || fscanf(in_fp, "%u %u %u", &r->hits, &r->misses, &r->evictions) != 3) {
+        printf("Error: %s failed on %s (status %d)\nSkipping performance evaluation for this function.\n",
+               sim, trace, flag);
+        if (in_fp != NULL)
+            fclose(in_fp);
+        r->correct = 0;
+        return;
+    }
+    fclose(in_fp);
+    printf("func %u (%s): hits:%u, misses:%u, evictions:%u\n",
+           i, func_desc(i), r->hits, r->misses, r->evictions);
+}
 
-	sprintf(tmpname, "/tmp/cs154p3-%u.tmp", (unsigned int)getuid());
-        sprintf(cmd, "valgrind --tool=lackey --trace-mem=yes --log-fd=1 -v ./tracegen -M %d -N %d -F %d  > %s",
-		M, N,i, tmpname);
-        flag=WEXITSTATUS(system(cmd));
-        if (0!=flag) {
-            printf("Validation error at function %d! Run ./tracegen -M %d -N %d -F %d for details.\nSkipping performance evaluation for this function.\n",flag-1,M,N,i);
-            continue;
+/*
+ * start_worker - Fork a process that evaluates function i with its
+ *     stdout going to a pipe
+ */
+void start_worker(struct worker *w, int i, unsigned int s, unsigned int E,
+                  unsigned int b, const char *cwd, struct func_result *r)
+{
+    int fds[2], rc;
+    char dir[256], path[512];
+
+    rc = pipe(fds);
+    assert(rc == 0);
+    fflush(stdout);
+    w->pid = fork();
+    assert(w->pid >= 0);
+    if (w->pid == 0) {
+        close(fds[0]);
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[1]);
+        /* Lines must reach the pipe before the commands' own output */
+        setvbuf(stdout, NULL, _IOLBF, 0);
+        alarm(0);
+
+        sprintf(dir, "/tmp/cs154p3-%u-XXXXXX", (unsigned int)getuid());
+        if (mkdtemp(dir) == NULL) {
+            printf("Error: cannot create %s\n", dir);
+            _exit(1);
         }
+        eval_func(i, s, E, b, dir, cwd, r);
+        /* The scratch files eval_func may have left */
+        sprintf(path, "%s/trace.tmp", dir);
+        unlink(path);
+        sprintf(path, "%s/marker", dir);
+        unlink(path);
+        sprintf(path, "%s/.csim_results", dir);
+        unlink(path);
+        rmdir(dir);
+        fflush(stdout);
+        _exit(0);
+    }
+    close(fds[1]);
+    w->fd = fds[0];
+    w->out = NULL;
+    w->len = 0;
+}
 
-        /* Get the start and end marker addresses */
-        FILE* marker_fp = fopen(".marker", "r");
-        assert(marker_fp);
-        fscanf(marker_fp, "%llx %llx", &marker_start, &marker_end);
-        fclose(marker_fp);
+/*
+ * eval_perf - Evaluate the performance of the registered transpose
+ *     functions, up to workers of them at a time. Each function's output
+ *     is held back until those registered before it have been printed.
+ */
+void eval_perf(unsigned int s, unsigned int E, unsigned int b)
+{
+    int i, k, n, next = 0, printed = 0, running = 0, total;
+    char cwd[PATH_MAX], buf[4096];
+    struct worker w[MAX_FUNCS];
+    struct pollfd pfd[MAX_FUNCS];
+    int who[MAX_FUNCS], done[MAX_FUNCS];
+    struct func_result *res;
+    ssize_t got;
 
+    registerFunctions();
+    total = func_counter + gfunc_counter;
+    alarm(TIMEOUT_BASE + TIMEOUT_PER_FUNC * total);
+    if (getcwd(cwd, sizeof(cwd)) == NULL) {
+        printf("Error: cannot get the current directory\n");
+        exit(1);
+    }
+
+    /* Workers write their results straight into this shared array */
+    res = mmap(NULL, sizeof(struct func_result) * MAX_FUNCS,
+               PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    assert(res != MAP_FAILED);
+    memset(res, 0, sizeof(struct func_result) * MAX_FUNCS);
+    memset(done, 0, sizeof(done));
 
-        func_list[i].correct=1;
+    for (i=0; i<func_counter; i++)
+        if (strcmp(func_list[i].description, SUBMIT_DESCRIPTION) == 0 )
+            results.funcid = i; /* remember which function is the submission */
 
-        /* Save the correctness of the transpose submission */
-        if (results.funcid == i ) {
-            results.correct = 1;
+    while (printed < total) {
+        while (next < total && running < workers) {
+            start_worker(&w[next], next, s, E, b, cwd, &res[next]);
+            next++;
+            running++;
         }
 
-        full_trace_fp = fopen(tmpname, "r");
-        assert(full_trace_fp);
+        /* Wait for output from any running worker */
+        for (i = printed, n = 0; i < next; i++)
+            if (!done[i] && w[i].fd >= 0) {
+                pfd[n].fd = w[i].fd;
+                pfd[n].events = POLLIN;
+                who[n++] = i;
+            }
+        if (poll(pfd, n, -1) < 0)
+            continue;
+        for (k = 0; k < n; k++) {
+            if (pfd[k].revents == 0)
+                continue;
+            i = who[k];
+            got = read(w[i].fd, buf, sizeof(buf));
+            if (got > 0) {
+                w[i].out = realloc(w[i].out, w[i].len + got);
+                assert(w[i].out);
+                memcpy(w[i].out + w[i].len, buf, got);
+                w[i].len += got;
+                continue;
+            }
+            /* End of output: the worker is finished */
+            close(w[i].fd);
+            w[i].fd = -1;
+            waitpid(w[i].pid, NULL, 0);
+            done[i] = 1;
+            running--;
+        }
 
+        /* Print, in registration order, whatever is complete */
+        while (printed < next && done[printed]) {
+            i = printed++;
+            fwrite(w[i].out, 1, w[i].len, stdout);
+            free(w[i].out);
+            if (i < func_counter) {
+                func_list[i].correct = res[i].correct;
+                func_list[i].num_hits = res[i].hits;
+                func_list[i].num_misses = res[i].misses;
+                func_list[i].num_evictions = res[i].evictions;
+            } else {
+                k = i - func_counter;
+                gfunc_list[k].correct = res[i].correct;
+                gfunc_list[k].num_hits = res[i].hits;
+                gfunc_list[k].num_misses = res[i].misses;
+                gfunc_list[k].num_evictions = res[i].evictions;
+            }
 
-        /* Filtered trace for each transpose function goes in a separate file */
-        sprintf(filename, "trace.f%d", i);
-        part_trace_fp = fopen(filename, "w");
-        assert(part_trace_fp);
-
-        /* Locate trace corresponding to the trans function */
-        flag = 0;
-        while (fgets(buf, 1000, full_trace_fp) != NULL) {
-
-            /* We are only interested in memory access instructions */
-            if (buf[0]==' ' && buf[2]==' ' &&
-                (buf[1]=='S' || buf[1]=='M' || buf[1]=='L' )) {
-                sscanf(buf+3, "%llx,%u", &addr, &len);
-
-                /* If start marker found, set flag */
-                if (addr == marker_start)
-                    flag = 1;
-
-                /* Valgrind creates many spurious accesses to the
-                   stack that have nothing to do with the students
-                   code. At the moment, we are ignoring all stack
-                   accesses by using the simple filter of recording
-                   accesses to only the low 32-bit portion of the
-                   address space. At some point it would be nice to
-                   try to do more informed filtering so that would
-                   eliminate the valgrind stack references while
-                   include the student stack references. */
-                if (flag && addr < 0xffffffff) {
-                    fputs(buf, part_trace_fp);
-                }
-
-                /* if end marker found, close trace file */
-                if (addr == marker_end) {
-                    flag = 0;
-                    fclose(part_trace_fp);
-                    break;
-                }
+            /* If it is transpose_submit(), record correctness and misses */
+            if (results.funcid == i && res[i].correct) {
+                results.correct = 1;
+                results.misses = res[i].misses;
             }
         }
-        fclose(full_trace_fp);
-
-        /* Run the reference simulator */
-        printf("Step 2: Evaluating performance (s=%d, E=%d, b=%d)\n", s, E, b);
-        char cmd[255];
-        sprintf(cmd, "./csim-ref -s %u -E %u -b %u -t trace.f%d > /dev/null",
-                s, E, b, i);
-        system(cmd);
-
-        /* Collect results from the reference simulator */
-        FILE* in_fp = fopen(".csim_results","r");
-        assert(in_fp);
-        fscanf(in_fp, "%u %u %u", &hits, &misses, &evictions);
-        fclose(in_fp);
-        func_list[i].num_hits = hits;
-        func_list[i].num_misses = misses;
-        func_list[i].num_evictions = evictions;
-        printf("func %u (%s): hits:%u, misses:%u, evictions:%u\n",
-               i, func_list[i].description, hits, misses, evictions);
-
-        /* If it is transpose_submit(), record number of misses */
-        if (results.funcid == i) {
-            results.misses = misses;
-        }
     }
-
+    fflush(stdout);
+    munmap(res, sizeof(struct func_result) * MAX_FUNCS);
 }
 
 /*
  * usage - Print usage info
  */
 void usage(char *argv[]){
-    printf("Usage: %s [-h] -M <rows> -N <cols>\n", argv[0]);
+    printf("Usage: %s [-hn] [-j <num>] -M <rows> -N <cols>\n", argv[0]);
     printf("Options:\n");
     printf("  -h          Print this help message.\n");
+    printf("  -n          Trace natively with tracegen-native instead of valgrind.\n");
+    printf("  -j <num>    Evaluate up to num functions at once (default: one per CPU).\n");
     printf("  -M <rows>   Number of matrix rows (max %d)\n", MAXN);
     printf("  -N <cols>   Number of  matrix columns (max %d)\n", MAXN);
     printf("Example: %s -M 8 -N 8\n", argv[0]);
@@ -201,7 +437,7 @@ int main(int argc, char* argv[])
 {
     char c;
 
-    while ((c = getopt(argc,argv,"M:N:h")) != -1) {
+    while ((c = getopt(argc,argv,"M:N:hnj:")) != -1) {
         switch(c) {
         case 'M':
             M = atoi(optarg);
@@ -209,6 +445,12 @@ int main(int argc, char* argv[])
         case 'N':
             N = atoi(optarg);
             break;
+        case 'n':
+            native = 1;
+            break;
+        case 'j':
+            workers = atoi(optarg);
+            break;
         case 'h':
             usage(argv);
             exit(0);
@@ -230,6 +472,11 @@ int main(int argc, char* argv[])
         exit(1);
     }
 
+    if (workers <= 0)
+        workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers <= 0)
+        workers = 1;
+
     /* Install SIGSEGV and SIGALRM handlers */
     if (signal(SIGSEGV, sigsegv_handler) == SIG_ERR) {
         fprintf(stderr, "Unable to install SIGALRM handler\n");
@@ -241,8 +488,9 @@ int main(int argc, char* argv[])
         exit(1);
     }
 
-    /* Time out and give up after a while */
-    alarm(120);
+    /* Time out and give up after a while; eval_perf extends this once it
+       knows how many functions there are */
+    alarm(TIMEOUT_BASE);
 
     /* Check the performance of the student's transpose function */
     eval_perf(5, 1, 5);
@@ -0,0 +1,197 @@
+/*
+ * trace.c - Reading and writing memory traces (see trace.h)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+
+/*
+ * trace_open - Open a trace, sniffing the magic to pick the format
+ */
+trace_file_t *trace_open(const char *path)
+{
+    char magic[TRACE_MAGIC_LEN];
+    trace_file_t *t;
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return NULL;
+
+    t = (trace_file_t*)malloc(sizeof(trace_file_t));
+    if (t == NULL) {
+        fclose(fp);
+        return NULL;
+    }
+    t->fp = fp;
+    t->count = 0;
+    t->next = 0;
+    t->binary = 0;
+    /* A file shorter than the magic can only be a (short) text trace */
+    if (fread(magic, 1, TRACE_MAGIC_LEN, fp) != TRACE_MAGIC_LEN)
+        rewind(fp);
+    else if (memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_LEN) == 0)
+        t->binary = 2;
+    else if (memcmp(magic, TRACE_MAGIC_V1, TRACE_MAGIC_LEN) == 0)
+        t->binary = 1;
+    else
+        rewind(fp);
+    return t;
+}
+
+/*
+ * parse_line - Parse one lackey line. Lines that are not I/L/S/M records
+ *     (valgrind banners, blank lines) are rejected with 0.
+ */
+static int parse_line(const char *p, trace_rec_t *rec)
+{
+    uint64_t addr = 0;
+    uint32_t size = 0, repeat = 0;
+    int digit;
+
+    while (*p == ' ')
+        p++;
+    if (*p != 'I' && *p != 'L' && *p != 'S' && *p != 'M')
+        return 0;
+    rec->op = *p++;
+    if (*p != ' ')
+        return 0;
+    while (*p == ' ')
+        p++;
+
+    for (;; p++) {
+        if (*p >= '0' && *p <= '9')
+            digit = *p - '0';
+        else if (*p >= 'a' && *p <= 'f')
+            digit = *p - 'a' + 10;
+        else if (*p >= 'A' && *p <= 'F')
+            digit = *p - 'A' + 10;
+        else
+            break;
+        addr = (addr << 4) | digit;
+    }
+    if (*p == ',')
+        for (p++; *p >= '0' && *p <= '9'; p++)
+            size = size * 10 + (*p - '0');
+    if (*p == ',')
+        for (p++; *p >= '0' && *p <= '9'; p++)
+            repeat = repeat * 10 + (*p - '0');
+
+    rec->addr = addr;
+    rec->size = size;
+    rec->repeat = repeat;
+    return 1;
+}
+
+/*
+ * read_v1 - Fill the buffer from a version 1 binary trace, converting
+ *     each record in place from the back so nothing is overwritten early
+ */
+static int read_v1(trace_file_t *t)
+{
+    trace_rec_v1_t *old = (trace_rec_v1_t*)t->buf;
+    int i, n = fread(old, sizeof(trace_rec_v1_t), TRACE_BUF_RECS, t->fp);
+    for (i = n - 1; i >= 0; i--) {
+        trace_rec_v1_t r = old[i];
+        t->buf[i].addr = r.addr;
+        t->buf[i].size = r.size;
+        t->buf[i].repeat = 0;
+        t->buf[i].op = r.op;
+    }
+    return n;
+}
+
+/*
+ * trace_next - Fetch the next record from either format
+ */
+int trace_next(trace_file_t *t, trace_rec_t *rec)
+{
+    char line[256];
+
+    if (t->binary == 1) {
+        if (t->next == t->count) {
+            t->count = read_v1(t);
+            t->next = 0;
+            if (t->count == 0)
+                return 0;
+        }
+        *rec = t->buf[t->next++];
+        return 1;
+    }
+    if (t->binary) {
+        if (t->next == t->count) {
+            t->count = fread(t->buf, sizeof(trace_rec_t), TRACE_BUF_RECS, t->fp);
+            t->next = 0;
+            if (t->count == 0)
+                return 0;
+        }
+        *rec = t->buf[t->next++];
+        return 1;
+    }
+
+    while (fgets(line, sizeof(line), t->fp) != NULL)
+        if (parse_line(line, rec))
+            return 1;
+    return 0;
+}
+
+void trace_close(trace_file_t *t)
+{
+    fclose(t->fp);
+    free(t);
+}
+
+int trace_write_header(FILE *fp)
+{
+    return fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_LEN, fp) == TRACE_MAGIC_LEN ? 0 : -1;
+}
+
+/*
+ * trace_format - Hand-rolled formatter; printf is the bottleneck when
+ *     writing hundreds of millions of lines
+ */
+int trace_format(char *buf, const trace_rec_t *rec)
+{
+    static const char hex[] = "0123456789abcdef";
+    char tmp[24];
+    int n = 0, len = 0;
+    uint64_t a = rec->addr;
+    uint32_t sz = rec->size;
+
+    if (rec->op == 'I') {
+        buf[len++] = 'I';
+        buf[len++] = ' ';
+        buf[len++] = ' ';
+    } else {
+        buf[len++] = ' ';
+        buf[len++] = rec->op;
+        buf[len++] = ' ';
+    }
+    do {
+        tmp[n++] = hex[a & 0xf];
+        a >>= 4;
+    } while (a);
+    /* lackey pads instruction addresses to 8 digits */
+    while (rec->op == 'I' && n < 8)
+        tmp[n++] = '0';
+    while (n)
+        buf[len++] = tmp[--n];
+    buf[len++] = ',';
+    do {
+        tmp[n++] = '0' + sz % 10;
+        sz /= 10;
+    } while (sz);
+    while (n)
+        buf[len++] = tmp[--n];
+    if (rec->repeat) {
+        uint32_t r = rec->repeat;
+        buf[len++] = ',';
+        do {
+            tmp[n++] = '0' + r % 10;
+            r /= 10;
+        } while (r);
+        while (n)
+            buf[len++] = tmp[--n];
+    }
+    buf[len++] = '\n';
+    return len;
+}
@@ -0,0 +1,67 @@
+/*
+ * trace.h - Reading and writing memory traces
+ *
+ * Two on-disk formats are understood. The text format is the one
+ * produced by valgrind's lackey tool (" L 7ff000,4", "I  0400d7d4,8").
+ * The binary format starts with the 8-byte magic TRACE_MAGIC and is
+ * followed by fixed-size trace_rec_t records in host byte order; it is
+ * much cheaper to write and parse for very large synthetic traces.
+ *
+ * A record may stand for a run of accesses to one cache line (see
+ * tracefilt): repeat counts the further accesses folded into it, all of
+ * which are hits. In text such a record carries a third field,
+ * " L 7ff000,4,7". Version 1 binary traces have no repeat field and
+ * are still read.
+ */
+#ifndef CSIM_TRACE_H
+#define CSIM_TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define TRACE_MAGIC "CSIMTRC2"
+#define TRACE_MAGIC_V1 "CSIMTRC1"
+#define TRACE_MAGIC_LEN 8
+
+/* Number of records buffered by the reader for binary traces */
+#define TRACE_BUF_RECS 4096
+
+typedef struct trace_rec {
+    uint64_t addr;
+    uint32_t size;
+    uint32_t repeat;  /* further same-line accesses folded in */
+    char op;          /* 'I', 'L', 'S' or 'M' */
+    char pad[7];
+} trace_rec_t;
+
+/* The version 1 binary record */
+typedef struct trace_rec_v1 {
+    uint64_t addr;
+    uint32_t size;
+    char op;
+    char pad[3];
+} trace_rec_v1_t;
+
+typedef struct trace_file {
+    FILE *fp;
+    int binary;       /* 0 for text, else the binary version */
+    int count;        /* records left in buf (binary only) */
+    int next;
+    trace_rec_t buf[TRACE_BUF_RECS];
+} trace_file_t;
+
+/* Open a trace in either format; returns NULL if it cannot be read */
+trace_file_t *trace_open(const char *path);
+
+/* Read the next record; returns 1 on success and 0 at end of trace */
+int trace_next(trace_file_t *t, trace_rec_t *rec);
+
+void trace_close(trace_file_t *t);
+
+/* Write the (current version) binary header to a fresh output stream */
+int trace_write_header(FILE *fp);
+
+/* Format one record as a lackey line into buf; returns its length */
+int trace_format(char *buf, const trace_rec_t *rec);
+
+#endif /* CSIM_TRACE_H */
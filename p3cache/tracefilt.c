@@ -0,0 +1,210 @@
+/*
+ * tracefilt.c - Filter and compact memory traces.
+ *
+ * Reads a trace in any format understood by trace.h and keeps only the
+ * requested operation types and address ranges. With -b, runs of
+ * consecutive data accesses to the same cache line are folded into the
+ * first record of the run, whose repeat field counts the accesses that
+ * were dropped (a modify counts twice, as in csim). Every folded access
+ * is a hit on the line the first one brought in, so csim gives exactly
+ * the same results on the compacted trace as long as it simulates lines
+ * of at least 2^b bytes.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <stdint.h>
+#include "trace.h"
+
+/* Records buffered before they are written out */
+#define BATCH 8192
+
+/* Most address ranges that may be given with -r or -x */
+#define MAX_RANGES 16
+
+typedef struct range {
+    uint64_t lo, hi;    /* [lo, hi) */
+} range_t;
+
+typedef struct writer {
+    FILE *fp;
+    int binary;
+    int n;
+    uint64_t count;
+    trace_rec_t recs[BATCH];
+    char text[BATCH * 40];
+} writer_t;
+
+/*
+ * flush - Write out the buffered records
+ */
+static int flush(writer_t *w)
+{
+    size_t len = 0;
+    int k;
+
+    if (w->binary) {
+        if (fwrite(w->recs, sizeof(trace_rec_t), w->n, w->fp) != (size_t)w->n)
+            return -1;
+    } else {
+        for (k = 0; k < w->n; k++)
+            len += trace_format(w->text + len, &w->recs[k]);
+        if (fwrite(w->text, 1, len, w->fp) != len)
+            return -1;
+    }
+    w->n = 0;
+    return 0;
+}
+
+static int put(writer_t *w, const trace_rec_t *rec)
+{
+    w->recs[w->n++] = *rec;
+    w->count++;
+    return w->n == BATCH ? flush(w) : 0;
+}
+
+/*
+ * parse_range - Parse "lo:hi" (any base strtoull accepts) into r
+ */
+static int parse_range(const char *s, range_t *r)
+{
+    char *end;
+    r->lo = strtoull(s, &end, 0);
+    if (*end != ':')
+        return -1;
+    r->hi = strtoull(end + 1, &end, 0);
+    return *end == '\0' && r->lo < r->hi ? 0 : -1;
+}
+
+static int in_ranges(const range_t *r, int n, uint64_t addr)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        if (addr >= r[i].lo && addr < r[i].hi)
+            return 1;
+    return 0;
+}
+
+/*
+ * usage - Print usage info
+ */
+void usage(char *argv[])
+{
+    printf("Usage: %s [-hB] -t <file> [-O <ops>] [-r <lo:hi>] [-x <lo:hi>] [-b <num>] [-o <file>]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h          Print this help message.\n");
+    printf("  -t <file>   Trace to filter (text or binary).\n");
+    printf("  -O <ops>    Keep only these operations, e.g. LSM (default ILSM).\n");
+    printf("  -r <lo:hi>  Keep only accesses in [lo, hi); may be repeated.\n");
+    printf("  -x <lo:hi>  Drop accesses in [lo, hi); may be repeated.\n");
+    printf("  -b <num>    Fold same-line runs for 2^b byte lines (csim -b must be >= num).\n");
+    printf("  -B          Write a binary trace instead of lackey text.\n");
+    printf("  -o <file>   Output file (default stdout).\n");
+    printf("Example: %s -t big.bin -O LSM -b 6 -B -o small.bin\n", argv[0]);
+}
+
+int main(int argc, char *argv[])
+{
+    int c, b = -1, nkeep = 0, ndrop = 0, have = 0;
+    char *trace = NULL, *outname = NULL, *ops = "ILSM";
+    range_t keep[MAX_RANGES], drop[MAX_RANGES];
+    uint64_t in = 0, line = 0, add;
+    trace_file_t *tf;
+    trace_rec_t rec, cur;
+    static writer_t w;
+
+    w.fp = stdout;
+    while ((c = getopt(argc, argv, "ht:O:r:x:b:Bo:")) != -1) {
+        switch (c) {
+        case 't': trace = optarg; break;
+        case 'O': ops = optarg; break;
+        case 'r':
+            if (nkeep == MAX_RANGES || parse_range(optarg, &keep[nkeep++]) < 0) {
+                printf("Error: Bad or too many ranges: %s\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'x':
+            if (ndrop == MAX_RANGES || parse_range(optarg, &drop[ndrop++]) < 0) {
+                printf("Error: Bad or too many ranges: %s\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'b': b = atoi(optarg); break;
+        case 'B': w.binary = 1; break;
+        case 'o': outname = optarg; break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+
+    if (trace == NULL) {
+        printf("Error: Missing required argument\n");
+        usage(argv);
+        exit(1);
+    }
+    if (b > 63) {
+        printf("Error: Invalid line size\n");
+        exit(1);
+    }
+    if ((tf = trace_open(trace)) == NULL) {
+        fprintf(stderr, "Error: could not open %s\n", trace);
+        exit(1);
+    }
+    if (outname != NULL && (w.fp = fopen(outname, "w")) == NULL) {
+        fprintf(stderr, "Error: could not open %s\n", outname);
+        exit(1);
+    }
+    setvbuf(w.fp, NULL, _IOFBF, 1 << 20);
+    if (w.binary && trace_write_header(w.fp) < 0)
+        goto fail;
+
+    while (trace_next(tf, &rec)) {
+        in++;
+        if (strchr(ops, rec.op) == NULL)
+            continue;
+        if (nkeep && !in_ranges(keep, nkeep, rec.addr))
+            continue;
+        if (ndrop && in_ranges(drop, ndrop, rec.addr))
+            continue;
+
+        /* Fold a data access into the run on its line if there is room */
+        add = 1 + (uint64_t)rec.repeat + (rec.op == 'M');
+        if (have && rec.op != 'I' && (rec.addr >> b) == line &&
+            cur.repeat + add <= UINT32_MAX) {
+            cur.repeat += add;
+            continue;
+        }
+        if (have && put(&w, &cur) < 0)
+            goto fail;
+        have = 0;
+
+        /* Instruction fetches are passed through and end the run */
+        if (rec.op == 'I' || b < 0) {
+            if (put(&w, &rec) < 0)
+                goto fail;
+            continue;
+        }
+        cur = rec;
+        line = rec.addr >> b;
+        have = 1;
+    }
+    trace_close(tf);
+    if ((have && put(&w, &cur) < 0) || flush(&w) < 0 || fclose(w.fp) != 0)
+        goto fail;
+
+    fprintf(stderr, "%llu records in, %llu out (%.2fx)\n",
+            (unsigned long long)in, (unsigned long long)w.count,
+            w.count ? (double)in / w.count : 0.0);
+    return 0;
+
+fail:
+    fprintf(stderr, "Error: write failed\n");
+    exit(1);
+}
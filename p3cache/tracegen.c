@@ -4,9 +4,19 @@
  *
  * The beginning and end of each registered transpose function's trace
  * is indicated by reading from "marker" addresses. These two marker
- * addresses are recorded in file for later use.
+ * addresses are recorded in file for later use, followed by the
+ * addresses of A and B (transtune places its arrays there).
+ *
+ * Built with -DTRACE_NATIVE (tracegen-native), trans.c reports its own
+ * matrix accesses through tracenative.h, and the ones made between the
+ * markers are kept in memory and written with -o as a filtered lackey
+ * trace, the same as test-trans cuts out of valgrind's output.
+ *
+ * Functions registered with registerTransGeneric are numbered after the
+ * int ones and run on matrices of their own element size.
  */
 
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
@@ -14,10 +24,13 @@
 #include <getopt.h>
 #include "cachelab.h"
 #include <string.h>
+#include "tracenative.h"
 
 /* External variables declared in cachelab.c */
 extern trans_func_t func_list[MAX_TRANS_FUNCS];
 extern int func_counter;
+extern trans_gfunc_t gfunc_list[MAX_TRANS_GFUNCS];
+extern int gfunc_counter;
 
 /* External function from trans.c */
 extern void registerFunctions();
@@ -25,11 +38,71 @@ extern void registerFunctions();
 /* Markers used to bound trace regions of interest */
 volatile char MARKER_START, MARKER_END;
 
+/* Largest element of a generic function */
+#define GMAX_SIZE 16
+
 static int A[256][256];
 static int B[256][256];
 static int M;
 static int N;
 
+/* Matrices for the generic functions, line aligned. They come from the
+   heap so that A and B sit where they always have in the graded trace. */
+static char *GA, *GB;
+#define GSIZE (256 * 256 * GMAX_SIZE)
+
+#ifdef TRACE_NATIVE
+/* One recorded access */
+typedef struct {
+    unsigned long long addr;
+    int size;
+    char op;
+} native_rec_t;
+
+static native_rec_t *native_recs;
+static size_t native_count, native_alloc;
+static int native_on;
+
+void trace_native_access(char op, const void *addr, int size)
+{
+    if (!native_on)
+        return;
+    if (native_count == native_alloc) {
+        native_alloc = native_alloc ? 2 * native_alloc : 65536;
+        native_recs = realloc(native_recs, native_alloc * sizeof(native_rec_t));
+        assert(native_recs);
+    }
+    native_recs[native_count].addr = (unsigned long long)addr;
+    native_recs[native_count].size = size;
+    native_recs[native_count].op = op;
+    native_count++;
+}
+
+void trace_native_rows(char op, const void *addr, size_t stride, int rows, int size)
+{
+    int r;
+    for (r = 0; r < rows; r++)
+        trace_native_access(op, (const char *)addr + r * stride, size);
+}
+
+/*
+ * native_write - Write the recorded accesses, between the two marker
+ *     stores lackey would report, as a lackey trace
+ */
+static void native_write(const char *path)
+{
+    size_t i;
+    FILE *fp = fopen(path, "w");
+    assert(fp);
+    fprintf(fp, " S %08llx,1\n", (unsigned long long)&MARKER_START);
+    for (i = 0; i < native_count; i++)
+        fprintf(fp, " %c %08llx,%d\n", native_recs[i].op, native_recs[i].addr,
+                native_recs[i].size);
+    fprintf(fp, " S %08llx,1\n", (unsigned long long)&MARKER_END);
+    fclose(fp);
+}
+#endif
+
 
 int validate(int fn,int M, int N, int A[N][M], int B[M][N]) {
     int C[M][N];
@@ -46,12 +119,49 @@ int validate(int fn,int M, int N, int A[N][M], int B[M][N]) {
     return 1;
 }
 
+/*
+ * validate_generic - validate for generic function g
+ */
+int validate_generic(int fn, int g) {
+    size_t size = gfunc_list[g].size, k;
+    char *C = malloc((size_t)M * N * size);
+    assert(C);
+    correctTransGeneric(M, N, size, GA, C);
+    for (k = 0; k < (size_t)M * N; k++) {
+        if (memcmp(GB + k * size, C + k * size, size) != 0) {
+            printf("Validation failed on function %d! Wrong element at B[%d][%d]\n",
+                   fn, (int)(k / N), (int)(k % N));
+            free(C);
+            return 0;
+        }
+    }
+    free(C);
+    return 1;
+}
+
+/*
+ * run_func - Run function i: an int function, or a generic one after them
+ */
+void run_func(int i) {
+    if (i < func_counter)
+        (*func_list[i].func_ptr)(M, N, A, B);
+    else
+        (*gfunc_list[i - func_counter].func_ptr)(M, N, GA, GB);
+}
+
+int check_func(int i) {
+    if (i < func_counter)
+        return validate(i, M, N, A, B);
+    return validate_generic(i, i - func_counter);
+}
+
 int main(int argc, char* argv[]){
-    int i;
+    int i, k;
 
     char c;
     int selectedFunc=-1;
-    while( (c=getopt(argc,argv,"M:N:F:")) != -1){
+    char *out = NULL, *marker = ".marker";
+    while( (c=getopt(argc,argv,"M:N:F:o:m:")) != -1){
         switch(c){
         case 'M':
             M = atoi(optarg);
@@ -62,6 +172,12 @@ int main(int argc, char* argv[]){
         case 'F':
             selectedFunc = atoi(optarg);
             break;
+        case 'o':
+            out = optarg;
+            break;
+        case 'm':
+            marker = optarg;
+            break;
         case '?':
         default:
             printf("./tracegen failed to parse its options.\n");
@@ -70,36 +186,78 @@ int main(int argc, char* argv[]){
     }
 
 
+#ifdef TRACE_NATIVE
+    if (out != NULL && selectedFunc < 0) {
+        printf("./tracegen-native: -o needs -F\n");
+        exit(1);
+    }
+#else
+    if (out != NULL) {
+        printf("./tracegen: -o is only supported by tracegen-native\n");
+        exit(1);
+    }
+#endif
+
     /*  Register transpose functions */
     registerFunctions();
+    if (selectedFunc >= func_counter + gfunc_counter) {
+        printf("./tracegen: no function %d\n", selectedFunc);
+        exit(1);
+    }
 
     /* Fill A with data */
     initMatrix(M,N, A, B);
+    if (gfunc_counter > 0) {
+        if (posix_memalign((void**)&GA, 64, GSIZE) != 0 ||
+            posix_memalign((void**)&GB, 64, GSIZE) != 0) {
+            printf("./tracegen: out of memory\n");
+            exit(1);
+        }
+        for (k = 0; k < GSIZE / sizeof(int); k++)
+            ((int*)GA)[k] = rand();
+    }
+    for (k = 0; k < gfunc_counter; k++)
+        if (gfunc_list[k].size > GMAX_SIZE) {
+            printf("./tracegen: elements of function %d are over %d bytes\n",
+                   func_counter + k, GMAX_SIZE);
+            exit(1);
+        }
 
     /* Record marker addresses */
-    FILE* marker_fp = fopen(".marker","w");
+    FILE* marker_fp = fopen(marker,"w");
     assert(marker_fp);
-    fprintf(marker_fp, "%llx %llx",
+    fprintf(marker_fp, "%llx %llx %llx %llx",
             (unsigned long long int) &MARKER_START,
-            (unsigned long long int) &MARKER_END );
+            (unsigned long long int) &MARKER_END,
+            (unsigned long long int) A,
+            (unsigned long long int) B );
     fclose(marker_fp);
 
     if (-1==selectedFunc) {
         /* Invoke registered transpose functions */
-        for (i=0; i < func_counter; i++) {
+        for (i=0; i < func_counter + gfunc_counter; i++) {
             MARKER_START = 33;
-            (*func_list[i].func_ptr)(M, N, A, B);
+            run_func(i);
             MARKER_END = 34;
-            if (!validate(i,M,N,A,B))
+            if (!check_func(i))
                 return i+1;
         }
     } else {
         MARKER_START = 33;
-        (*func_list[selectedFunc].func_ptr)(M, N, A, B);
+#ifdef TRACE_NATIVE
+        native_on = 1;
+#endif
+        run_func(selectedFunc);
+#ifdef TRACE_NATIVE
+        native_on = 0;
+#endif
         MARKER_END = 34;
-        if (!validate(selectedFunc,M,N,A,B))
+        if (!check_func(selectedFunc))
             return selectedFunc+1;
-
+#ifdef TRACE_NATIVE
+        if (out != NULL)
+            native_write(out);
+#endif
     }
     return 0;
 }
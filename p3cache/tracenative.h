@@ -0,0 +1,52 @@
+/*
+ * tracenative.h - Access hooks for tracegen-native
+ *
+ * Built with -DTRACE_NATIVE, trans.c reads and writes its matrices
+ * through these hooks instead of directly, and tracegen records every
+ * access made between its markers without valgrind. The default build
+ * is unaffected: the hooks only exist under TRACE_NATIVE, and the access
+ * macros of transched.h, transimd.h and transgen.h then expand to plain
+ * accesses.
+ *
+ * Only matrix accesses are recorded. Loads of globals that lackey would
+ * also report (the function pointer, M, N, trans.c's own statics) are
+ * not, so a native trace can come out a few misses short. An element of
+ * transgen.h is one access of its own size, where lackey reports each
+ * move the compiler made to copy it.
+ */
+#ifndef TRACENATIVE_H
+#define TRACENATIVE_H
+
+#ifdef TRACE_NATIVE
+#include <stddef.h>
+
+/* Defined in tracegen.c */
+void trace_native_access(char op, const void *addr, int size);
+void trace_native_rows(char op, const void *addr, size_t stride, int rows, int size);
+
+static inline int ts_load(const int *p)
+{
+    trace_native_access('L', p, sizeof(int));
+    return *p;
+}
+
+/* The value, and so its load, is evaluated before the store is recorded */
+static inline void ts_store(int *p, int v)
+{
+    trace_native_access('S', p, sizeof(int));
+    *p = v;
+}
+
+#define TS_LOAD(X, r, c) ts_load(&X[r][c])
+#define TS_STORE(X, r, c, v) ts_store(&X[r][c], (v))
+#define TS_VROWS(op, X, r, c, rows, size) \
+    trace_native_rows(op, &X[r][c], sizeof(X[0]), rows, size)
+
+/* Any element type; the stored value must not itself be a recorded load */
+#define TG_LOAD(X, r, c) \
+    (trace_native_access('L', &X[r][c], sizeof(X[r][c])), X[r][c])
+#define TG_STORE(X, r, c, v) \
+    (trace_native_access('S', &X[r][c], sizeof(X[r][c])), X[r][c] = (v))
+#endif
+
+#endif /* TRACENATIVE_H */
@@ -0,0 +1,719 @@
+/*
+ * trans-bench.c - Times the registered transpose functions on the host.
+ *
+ * test-trans counts simulated misses; this measures what the same code
+ * costs on the machine it runs on. trans.c is compiled in at -O2 and
+ * every function it registers (and correctTrans as a naive baseline) is
+ * run on each size. Times are taken with the TSC and the K-best scheme
+ * of p5malloc's fcyc.c, and reported as ticks per element and GB/s of
+ * matrix data read and written. Where perf_event_open is allowed, core
+ * cycles per element and last-level and L1D read misses per call are
+ * counted as well, and for sizes test-trans can trace, the simulated
+ * misses from tracegen-native and csim-ref are put alongside. A
+ * function that does not transpose a size correctly is reported as wrong.
+ * Functions of other element types are timed on matrices of their own
+ * type, and their GB/s counts their own element size.
+ *
+ * With -j, the threaded transpose of transpar.c is timed instead, from
+ * one thread up to -j, to show how it scales on large matrices. With
+ * -i, the in-place transposes of transip.c are compared with the SIMD
+ * out-of-place transpose, in time and in the memory each needs beyond A.
+ * With -w, the staged tiles of trans_stream are timed with ordinary
+ * stores and with non-temporal ones, from sizes that fit in the
+ * last-level cache to sizes well beyond it.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "cachelab.h"
+#include "transimd.h"
+#include "transpar.h"
+#include "transip.h"
+
+/* External variables declared in cachelab.c */
+extern trans_func_t func_list[MAX_TRANS_FUNCS];
+extern int func_counter;
+extern trans_gfunc_t gfunc_list[MAX_TRANS_GFUNCS];
+extern int gfunc_counter;
+
+/* External function from trans.c */
+extern void registerFunctions();
+
+/* Sizes benchmarked when -M and -N are not given */
+static const int bench_M[] = {32, 64, 61, 256, 1024, 1000};
+static const int bench_N[] = {32, 64, 67, 256, 1024, 1000};
+#define NUM_SIZES (sizeof(bench_M) / sizeof(bench_M[0]))
+
+/* K-best timing, as in p5malloc's fcyc.c: keep sampling until the K
+   fastest samples are within EPSILON of each other, or give up after
+   MAX_SAMPLES and take the fastest */
+#define KBEST 3
+#define EPSILON 0.01
+#define MAX_SAMPLES 20
+
+/* Shortest sample, in TSC ticks, so the timer and the loop are not the noise */
+#define MIN_SAMPLE_TICKS 200000.0
+
+/* Size for -j when -M and -N are not given */
+#define PAR_DEFAULT 8192
+
+/* Square sizes for -w when -M and -N are not given */
+static const int stream_sizes[] = {256, 512, 1024, 2048, 4096};
+#define NUM_STREAM_SIZES (sizeof(stream_sizes) / sizeof(stream_sizes[0]))
+
+/* Largest size test-trans can trace, and so report simulated misses for */
+#define SIM_MAXN 256
+
+/* Globals set on the command line */
+static int reps = 5;
+static int kbest = KBEST;
+static int sweep = 0;
+static char *filter = NULL;
+
+/* TSC ticks per second, measured at start-up */
+static double tsc_hz;
+
+/* Hardware counters, or -1 where perf_event_open is not available */
+enum { EV_CYCLES, EV_LLC_MISSES, EV_L1D_MISSES, NUM_EVENTS };
+static int perf_fd[NUM_EVENTS] = {-1, -1, -1};
+
+/* What bench_func measured for one function, per call */
+struct bench_result {
+    double ticks;
+    double events[NUM_EVENTS];  /* negative when not counted */
+};
+
+/*
+ * now - Monotonic time in seconds
+ */
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * ticks - A cycle-rate timestamp: the TSC on x86, nanoseconds elsewhere
+ */
+static inline double ticks(void)
+{
+#if TRANS_SIMD
+    unsigned int lo, hi;
+    __asm__ __volatile__("lfence; rdtsc" : "=a"(lo), "=d"(hi) :: "memory");
+    return (double)(((unsigned long long)hi << 32) | lo);
+#else
+    return now() * 1e9;
+#endif
+}
+
+/*
+ * calibrate_tsc - Measure the tick rate against the monotonic clock
+ */
+static void calibrate_tsc(void)
+{
+    double t0 = now(), c0 = ticks(), t1;
+    while ((t1 = now()) - t0 < 0.05)
+        ;
+    tsc_hz = (ticks() - c0) / (t1 - t0);
+}
+
+static int perf_open(unsigned int type, unsigned long long config, int group)
+{
+    struct perf_event_attr pe;
+
+    memset(&pe, 0, sizeof(pe));
+    pe.size = sizeof(pe);
+    pe.type = type;
+    pe.config = config;
+    pe.disabled = group < 0;
+    pe.exclude_kernel = 1;
+    pe.exclude_hv = 1;
+    return (int)syscall(__NR_perf_event_open, &pe, 0, -1, group, 0);
+}
+
+/*
+ * open_counters - Open cycles, last-level cache misses and L1D read
+ *     misses as one group; whichever the kernel refuses stays at -1
+ */
+static void open_counters(void)
+{
+    perf_fd[EV_CYCLES] = perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+    if (perf_fd[EV_CYCLES] < 0)
+        return;
+    perf_fd[EV_LLC_MISSES] = perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,
+                                       perf_fd[EV_CYCLES]);
+    perf_fd[EV_L1D_MISSES] = perf_open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                                       (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                       (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+                                       perf_fd[EV_CYCLES]);
+}
+
+/*
+ * is_correct - Check B against A after a transpose
+ */
+static int is_correct(int M, int N, int *a, int *b)
+{
+    int i, j;
+    for (i = 0; i < N; i++)
+        for (j = 0; j < M; j++)
+            if (b[j * N + i] != a[i * M + j])
+                return 0;
+    return 1;
+}
+
+/*
+ * is_correct_generic - is_correct for elements of size bytes
+ */
+static int is_correct_generic(int M, int N, size_t size, const char *a, const char *b)
+{
+    int i, j;
+    for (i = 0; i < N; i++)
+        for (j = 0; j < M; j++)
+            if (memcmp(b + ((size_t)j * N + i) * size, a + ((size_t)i * M + j) * size,
+                       size) != 0)
+                return 0;
+    return 1;
+}
+
+/*
+ * func_size - Element size of function f: -1 is correctTrans, then the
+ *     int functions, then the generic ones, as tracegen numbers them
+ */
+static size_t func_size(int f)
+{
+    return f < func_counter ? sizeof(int) : gfunc_list[f - func_counter].size;
+}
+
+/*
+ * func_desc - Description of function f
+ */
+static char *func_desc(int f)
+{
+    if (f < 0)
+        return "Naive (correctTrans)";
+    return f < func_counter ? func_list[f].description
+                            : gfunc_list[f - func_counter].description;
+}
+
+/*
+ * call_func - Run function f on a and b, cast to its element type
+ */
+static inline void call_func(int f, int M, int N, void *a, void *b)
+{
+    if (f < 0)
+        correctTrans(M, N, (int (*)[M])a, (int (*)[N])b);
+    else if (f < func_counter)
+        func_list[f].func_ptr(M, N, (int (*)[M])a, (int (*)[N])b);
+    else
+        gfunc_list[f - func_counter].func_ptr(M, N, a, b);
+}
+
+/*
+ * add_sample - Insert val into the sorted list of the k fastest samples
+ */
+static void add_sample(double *best, int *count, double val)
+{
+    int pos;
+    double t;
+
+    if (*count < kbest)
+        pos = (*count)++;
+    else if (val < best[kbest - 1])
+        pos = kbest - 1;
+    else
+        return;
+    best[pos] = val;
+    while (pos > 0 && best[pos - 1] > best[pos]) {
+        t = best[pos - 1];
+        best[pos - 1] = best[pos];
+        best[pos] = t;
+        pos--;
+    }
+}
+
+/*
+ * bench_func - Time function f on one size with the K-best scheme and
+ *     count its hardware events; returns 0, or -1 if its result is wrong
+ */
+static int bench_func(int f, int M, int N, void *a, void *b, struct bench_result *res)
+{
+    double best[KBEST * 4], start, val;
+    long iters = 1, k;
+    int count = 0, samples, e;
+    unsigned long long v;
+    size_t size = func_size(f);
+
+    memset(b, 0, size * M * N);
+    call_func(f, M, N, a, b);
+    if (size == sizeof(int) ? !is_correct(M, N, a, b) : !is_correct_generic(M, N, size, a, b))
+        return -1;
+
+    /* Grow the call count until a sample is long enough to time */
+    for (;;) {
+        start = ticks();
+        for (k = 0; k < iters; k++)
+            call_func(f, M, N, a, b);
+        if ((val = ticks() - start) >= MIN_SAMPLE_TICKS)
+            break;
+        iters *= 2;
+    }
+    add_sample(best, &count, val / iters);
+    for (samples = 1; samples < MAX_SAMPLES; samples++) {
+        if (count >= kbest && (1 + EPSILON) * best[0] >= best[kbest - 1])
+            break;
+        start = ticks();
+        for (k = 0; k < iters; k++)
+            call_func(f, M, N, a, b);
+        add_sample(best, &count, (ticks() - start) / iters);
+    }
+    res->ticks = best[0];
+
+    /* One more batch under the counters */
+    for (e = 0; e < NUM_EVENTS; e++)
+        res->events[e] = -1;
+    if (perf_fd[EV_CYCLES] >= 0) {
+        ioctl(perf_fd[EV_CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(perf_fd[EV_CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        for (k = 0; k < iters; k++)
+            call_func(f, M, N, a, b);
+        ioctl(perf_fd[EV_CYCLES], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        for (e = 0; e < NUM_EVENTS; e++)
+            if (perf_fd[e] >= 0 && read(perf_fd[e], &v, sizeof(v)) == sizeof(v))
+                res->events[e] = (double)v / iters;
+    }
+    return 0;
+}
+
+/*
+ * run_quiet - Run argv in directory dir with its output discarded; returns
+ *     whether it exited with status 0
+ */
+static int run_quiet(char *const argv[], const char *dir)
+{
+    pid_t pid;
+    int fd, status;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0)
+        return 0;
+    if (pid == 0) {
+        if (chdir(dir) < 0 || (fd = open("/dev/null", O_WRONLY)) < 0)
+            _exit(127);
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        close(fd);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    return waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+        WEXITSTATUS(status) == 0;
+}
+
+/*
+ * sim_misses - Simulated misses of registered function f on the graded
+ *     cache, from tracegen-native and csim-ref as test-trans -n gets
+ *     them; -1 if the size is too large to trace or the tools are missing
+ */
+static long sim_misses(int f, int M, int N)
+{
+    char dir[64], cwd[PATH_MAX], gen[PATH_MAX + 32], sim[PATH_MAX + 32];
+    char path[128], Ms[16], Ns[16], Fs[16];
+    char *gen_argv[] = {gen, "-M", Ms, "-N", Ns, "-F", Fs, "-m", "marker",
+                        "-o", "trace", NULL};
+    char *sim_argv[] = {sim, "-s", "5", "-E", "1", "-b", "5", "-t", "trace", NULL};
+    unsigned int hits, misses = 0, evictions;
+    long result = -1;
+    FILE *fp;
+
+    if (M > SIM_MAXN || N > SIM_MAXN || getcwd(cwd, sizeof(cwd)) == NULL)
+        return -1;
+    if (snprintf(gen, sizeof(gen), "%s/tracegen-native", cwd) >= (int)sizeof(gen) ||
+        snprintf(sim, sizeof(sim), "%s/csim-ref", cwd) >= (int)sizeof(sim))
+        return -1;
+    sprintf(Ms, "%d", M);
+    sprintf(Ns, "%d", N);
+    sprintf(Fs, "%d", f);
+    sprintf(dir, "/tmp/trans-bench-%u-XXXXXX", (unsigned int)getuid());
+    if (mkdtemp(dir) == NULL)
+        return -1;
+    sprintf(path, "%s/.csim_results", dir);
+    if (run_quiet(gen_argv, dir) && run_quiet(sim_argv, dir) &&
+        (fp = fopen(path, "r")) != NULL) {
+        if (fscanf(fp, "%u %u %u", &hits, &misses, &evictions) == 3)
+            result = misses;
+        fclose(fp);
+    }
+    unlink(path);
+    sprintf(path, "%s/marker", dir);
+    unlink(path);
+    sprintf(path, "%s/trace", dir);
+    unlink(path);
+    if (rmdir(dir) != 0)
+        fprintf(stderr, "Warning: could not remove %s\n", dir);
+    return result;
+}
+
+/*
+ * print_result - One row of the default table
+ */
+static void print_result(int M, int N, int f, const struct bench_result *r, long sim)
+{
+    double elems = (double)M * N;
+    char col[NUM_EVENTS][32], simcol[32];
+    int e;
+
+    for (e = 0; e < NUM_EVENTS; e++) {
+        if (r->events[e] < 0)
+            strcpy(col[e], "-");
+        else
+            sprintf(col[e], e == EV_CYCLES ? "%.3f" : "%.0f",
+                    e == EV_CYCLES ? r->events[e] / elems : r->events[e]);
+    }
+    if (sim < 0)
+        strcpy(simcol, "-");
+    else
+        sprintf(simcol, "%ld", sim);
+    printf("%5dx%-5d %-44.44s %8.3f %8.2f %9s %9s %9s %8s\n", M, N, func_desc(f),
+           r->ticks / elems, 2.0 * func_size(f) * elems / (r->ticks / tsc_hz) / 1e9,
+           col[EV_CYCLES], col[EV_LLC_MISSES], col[EV_L1D_MISSES], simcol);
+}
+
+/*
+ * bench_size - Run the naive baseline and every selected function on one
+ *     size
+ */
+static void bench_size(int M, int N)
+{
+    /* Slack keeps kernels written for one fixed size (trans_final reaches
+       row 66 and column 60 whatever it is given) inside the arrays */
+    size_t n = (size_t)(M + 64) * (N + 64), size = sizeof(int), i;
+    struct bench_result r;
+    int f, *a, *b;
+
+    /* Room for the largest element; each int of A differs, so each
+       element of any size does */
+    for (f = 0; f < gfunc_counter; f++)
+        if (gfunc_list[f].size > size)
+            size = gfunc_list[f].size;
+    /* Line aligned, so trans_streaming is timed streaming, not falling back */
+    if (posix_memalign((void**)&a, 64, size * n) != 0 ||
+        posix_memalign((void**)&b, 64, size * n) != 0) {
+        fprintf(stderr, "Error: out of memory for %dx%d\n", M, N);
+        exit(1);
+    }
+    for (i = 0; i < size * n / sizeof(int); i++)
+        a[i] = (int)i;
+
+    bench_func(-1, M, N, a, b, &r);
+    print_result(M, N, -1, &r, -1);
+    for (f = 0; f < func_counter + gfunc_counter; f++) {
+        if (filter != NULL && strstr(func_desc(f), filter) == NULL)
+            continue;
+        if (bench_func(f, M, N, a, b, &r) < 0)
+            printf("%5dx%-5d %-44.44s %8s\n", M, N, func_desc(f), "wrong");
+        else
+            print_result(M, N, f, &r, sim_misses(f, M, N));
+    }
+    free(a);
+    free(b);
+}
+
+/*
+ * bench_threads - Time the thread pool on one size with 1 to max threads
+ */
+static void bench_threads(int M, int N, int max)
+{
+    size_t n = (size_t)M * N;
+    int *a = NULL, *b = NULL;
+    double one = 0, secs, start;
+    size_t i;
+    int t, r;
+
+    /* Line-aligned B, so bands of different threads share no lines */
+    if (posix_memalign((void**)&a, 64, sizeof(int) * n) != 0 ||
+        posix_memalign((void**)&b, 64, sizeof(int) * n) != 0) {
+        fprintf(stderr, "Error: out of memory for %dx%d\n", M, N);
+        exit(1);
+    }
+    for (i = 0; i < n; i++)
+        a[i] = (int)i;
+
+    printf("%-11s %8s %10s %8s %8s %10s\n", "size", "threads", "ms", "GB/s", "speedup",
+           "efficiency");
+    for (t = 1; t <= max; t++) {
+        trans_pool_t *pool = trans_pool_create(t);
+        if (pool == NULL) {
+            fprintf(stderr, "Error: could not start %d threads\n", t);
+            exit(1);
+        }
+        memset(b, 0, sizeof(int) * n);
+        trans_pool_run(pool, M, N, (int (*)[M])a, (int (*)[N])b);
+        if (!is_correct(M, N, a, b)) {
+            printf("%5dx%-5d %8d %10s\n", M, N, t, "wrong");
+            trans_pool_destroy(pool);
+            continue;
+        }
+        secs = -1;
+        for (r = 0; r < reps; r++) {
+            start = now();
+            trans_pool_run(pool, M, N, (int (*)[M])a, (int (*)[N])b);
+            start = now() - start;
+            if (secs < 0 || start < secs)
+                secs = start;
+        }
+        trans_pool_destroy(pool);
+        if (t == 1)
+            one = secs;
+        printf("%5dx%-5d %8d %10.2f %8.2f %7.2fx %9.0f%%\n", M, N, t, secs * 1e3,
+               8.0 * n / secs / 1e9, one / secs, 100.0 * one / secs / t);
+    }
+    free(a);
+    free(b);
+}
+
+/*
+ * bench_inplace - Compare trans_inplace with the out-of-place SIMD tiles
+ *     on one size
+ */
+static void bench_inplace(int M, int N)
+{
+    size_t n = (size_t)M * N, i;
+    int *a = (int*)malloc(sizeof(int) * n);
+    int *b = (int*)malloc(sizeof(int) * n);
+    int *c = (int*)malloc(sizeof(int) * n);
+    double out = -1, in = -1, secs;
+    int r, m = M, rows = N;
+
+    if (a == NULL || b == NULL || c == NULL) {
+        fprintf(stderr, "Error: out of memory for %dx%d\n", M, N);
+        exit(1);
+    }
+    /* Touch B first so its page faults are not timed */
+    for (i = 0; i < n; i++) {
+        a[i] = c[i] = (int)i;
+        b[i] = 0;
+    }
+
+    for (r = 0; r < reps; r++) {
+        secs = now();
+        trans_simd_tile(M, N, (int (*)[M])a, (int (*)[N])b, 0, N, 0, M);
+        secs = now() - secs;
+        if (out < 0 || secs < out)
+            out = secs;
+    }
+    if (trans_inplace(M, N, c) < 0) {
+        fprintf(stderr, "Error: out of memory for %dx%d\n", M, N);
+        exit(1);
+    }
+    if (memcmp(b, c, sizeof(int) * n) != 0) {
+        printf("%5dx%-5d %10s\n", M, N, "wrong");
+        goto done;
+    }
+    /* c now holds the M x N transpose; each run flips it back and forth */
+    m = N;
+    rows = M;
+    for (r = 0; r < reps; r++) {
+        secs = now();
+        trans_inplace(m, rows, c);
+        secs = now() - secs;
+        m = m == M ? N : M;
+        rows = rows == M ? N : M;
+        if (in < 0 || secs < in)
+            in = secs;
+    }
+    printf("%5dx%-5d %10.3f %8.2f %10.3f %8.2f %7.2fx %10.1f %10.3f\n", M, N,
+           out * 1e3, 8.0 * n / out / 1e9, in * 1e3, 8.0 * n / in / 1e9, out / in,
+           sizeof(int) * n / 1048576.0, trans_inplace_extra(M, N) / 1048576.0);
+done:
+    free(a);
+    free(b);
+    free(c);
+}
+
+/*
+ * bench_stream - Compare ordinary and non-temporal stores on one size
+ */
+static void bench_stream(int M, int N, long llc)
+{
+    size_t n = (size_t)M * N, i;
+    int *a = NULL, *b = NULL;
+    double cached = -1, nt = -1, secs;
+    int r;
+
+    /* Line-aligned B, so every 16-int segment of a row is a whole line */
+    if (posix_memalign((void**)&a, 64, sizeof(int) * n) != 0 ||
+        posix_memalign((void**)&b, 64, sizeof(int) * n) != 0) {
+        fprintf(stderr, "Error: out of memory for %dx%d\n", M, N);
+        exit(1);
+    }
+    for (i = 0; i < n; i++) {
+        a[i] = (int)i;
+        b[i] = 0;
+    }
+
+    if (!trans_stream_ok(N, b)) {
+        printf("%5dx%-5d  no streaming stores (they need SIMD and N a multiple of 16)\n", M, N);
+        goto done;
+    }
+    for (r = 0; r < 2; r++) {
+        memset(b, 0, sizeof(int) * n);
+        trans_staged(M, N, (int (*)[M])a, (int (*)[N])b, r);
+        if (!is_correct(M, N, a, b)) {
+            printf("%5dx%-5d %10s\n", M, N, "wrong");
+            goto done;
+        }
+    }
+    for (r = 0; r < reps; r++) {
+        secs = now();
+        trans_staged(M, N, (int (*)[M])a, (int (*)[N])b, 0);
+        secs = now() - secs;
+        if (cached < 0 || secs < cached)
+            cached = secs;
+        secs = now();
+        trans_stream(M, N, (int (*)[M])a, (int (*)[N])b);
+        secs = now() - secs;
+        if (nt < 0 || secs < nt)
+            nt = secs;
+    }
+    printf("%5dx%-5d %8.1f %6s %10.3f %8.2f %10.3f %8.2f %7.2fx\n", M, N,
+           2.0 * sizeof(int) * n / 1048576.0,
+           llc <= 0 ? "?" : 2 * sizeof(int) * n > (size_t)llc ? "yes" : "no",
+           cached * 1e3, 8.0 * n / cached / 1e9, nt * 1e3, 8.0 * n / nt / 1e9,
+           cached / nt);
+done:
+    free(a);
+    free(b);
+}
+
+/*
+ * usage - Print usage info
+ */
+void usage(char *argv[])
+{
+    printf("Usage: %s [-h] [-M <num> -N <num> | -S <max>] [-k <num>] [-r <num>]\n", argv[0]);
+    printf("       [-f <text> | -j <num> | -i | -w]\n");
+    printf("Options:\n");
+    printf("  -h          Print this help message.\n");
+    printf("  -M <num>    Columns of A (default: a fixed set of sizes).\n");
+    printf("  -N <num>    Rows of A.\n");
+    printf("  -S <max>    Sweep square sizes 32, 33, 64, 65, ... up to max.\n");
+    printf("  -k <num>    K of the K-best timing (default %d, at most %d).\n", KBEST, 4 * KBEST);
+    printf("  -r <num>    Repetitions for -j and -i; the fastest is kept (default %d).\n", reps);
+    printf("  -f <text>   Only functions whose description contains text.\n");
+    printf("  -j <num>    Time the threaded transpose with 1 to num threads\n");
+    printf("              (default size %dx%d).\n", PAR_DEFAULT, PAR_DEFAULT);
+    printf("  -i          Compare the in-place transposes with out-of-place.\n");
+    printf("  -w          Compare ordinary stores with non-temporal stores.\n");
+    printf("Examples:\n");
+    printf("  %s -M 1024 -N 1024 -f SIMD\n", argv[0]);
+    printf("  %s -S 2048 -f Recursive\n", argv[0]);
+    printf("  %s -M 16384 -N 16384 -j 8\n", argv[0]);
+    printf("  %s -w -r 10\n", argv[0]);
+}
+
+int main(int argc, char *argv[])
+{
+    int c, M = 0, N = 0, threads = 0, inplace = 0, stream = 0;
+    long llc;
+    unsigned int i;
+    static const char *level[] = {"scalar", "", "", "", "SSE2", "", "", "", "AVX2"};
+
+    while ((c = getopt(argc, argv, "hM:N:S:k:r:f:j:iw")) != -1) {
+        switch (c) {
+        case 'M': M = atoi(optarg); break;
+        case 'N': N = atoi(optarg); break;
+        case 'S': sweep = atoi(optarg); break;
+        case 'k': kbest = atoi(optarg); break;
+        case 'r': reps = atoi(optarg); break;
+        case 'f': filter = optarg; break;
+        case 'j': threads = atoi(optarg); break;
+        case 'i': inplace = 1; break;
+        case 'w': stream = 1; break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+    if ((M != 0 || N != 0) && (M <= 0 || N <= 0)) {
+        printf("Error: -M and -N must both be positive\n");
+        usage(argv);
+        exit(1);
+    }
+    if (reps < 1)
+        reps = 1;
+    if (kbest < 1 || kbest > 4 * KBEST) {
+        printf("Error: -k must be between 1 and %d\n", 4 * KBEST);
+        exit(1);
+    }
+
+    if (threads > 0) {
+        bench_threads(M > 0 ? M : PAR_DEFAULT, N > 0 ? N : PAR_DEFAULT, threads);
+        return 0;
+    }
+
+    if (inplace) {
+        printf("%-11s %10s %8s %10s %8s %8s %10s %10s\n", "size", "out ms", "GB/s",
+               "in ms", "GB/s", "relative", "B MB", "extra MB");
+        if (M > 0) {
+            bench_inplace(M, N);
+        } else {
+            for (i = 0; i < NUM_SIZES; i++)
+                bench_inplace(bench_M[i], bench_N[i]);
+        }
+        return 0;
+    }
+
+    if (stream) {
+        llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+        if (llc <= 0)
+            llc = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        if (llc > 0)
+            printf("last-level cache: %.1f MB\n", llc / 1048576.0);
+        else
+            printf("last-level cache: unknown\n");
+        printf("%-11s %8s %6s %10s %8s %10s %8s %8s\n", "size", "A+B MB", "> LLC",
+               "store ms", "GB/s", "stream ms", "GB/s", "gain");
+        if (M > 0) {
+            bench_stream(M, N, llc);
+        } else {
+            for (i = 0; i < NUM_STREAM_SIZES; i++)
+                bench_stream(stream_sizes[i], stream_sizes[i], llc);
+        }
+        return 0;
+    }
+
+    registerFunctions();
+    calibrate_tsc();
+    open_counters();
+    printf("kernels: %s, %.2f GHz ticks, perf counters: %s\n", level[trans_simd_level()],
+           tsc_hz / 1e9, perf_fd[EV_CYCLES] >= 0 ? "yes" : "unavailable");
+    printf("%-11s %-44s %8s %8s %9s %9s %9s %8s\n", "size", "function", "tick/el",
+           "GB/s", "cyc/el", "LLC-miss", "L1D-miss", "sim-miss");
+    if (M > 0) {
+        bench_size(M, N);
+    } else if (sweep > 0) {
+        for (c = 32; c <= sweep; c *= 2) {
+            bench_size(c, c);
+            bench_size(c + 1, c + 1);
+        }
+    } else {
+        for (i = 0; i < NUM_SIZES; i++)
+            bench_size(bench_M[i], bench_N[i]);
+    }
+    return 0;
+}
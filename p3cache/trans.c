@@ -9,6 +9,10 @@
  */
 #include <stdio.h>
 #include "cachelab.h"
+#include "tracenative.h"
+#include "transched.h"
+#include "transimd.h"
+#include "transgen.h"
 
 #define ROW_SIZE1 8
 #define COL_SIZE1 8
@@ -19,8 +23,39 @@
 #define ROW_SIZE3 8
 #define COL_SIZE3 4
 
+/* The graded cache: 1KB direct mapped with 32-byte blocks */
+#define GRADED_S 5
+#define GRADED_E 1
+#define GRADED_B 5
+
+#define MAX_SCHEDS 32
+
+/* Largest tile trans_recursive hands to its base case; one block of ints */
+#define CO_BASE 8
+
+/* In trans_recursive_simd the recursion stops at tiles this big, which
+   the kernels walk 8x8 at a time; smaller leaves cost more in calls than
+   they save in misses */
+#define CO_SIMD_LEAF 32
+
 int is_transpose(int M, int N, int A[N][M], int B[M][N]);
 
+/* Schedules for the graded cache from transtune, read at registration */
+static trans_sched_t schedules[MAX_SCHEDS];
+static int num_schedules;
+
+/*
+ * find_schedule - The tuned schedule for an N x M matrix, or NULL
+ */
+static const trans_sched_t *find_schedule(int M, int N)
+{
+    int i;
+    for (i = 0; i < num_schedules; i++)
+        if (schedules[i].M == M && schedules[i].N == N)
+            return &schedules[i];
+    return NULL;
+}
+
 
 
 /*
@@ -48,18 +83,18 @@ void trans(int M, int N, int A[N][M], int B[M][N])
 	    // We need to check if it's a diagonal
 	    if (i == j)
 	      {
-		same = A[i][j];
+		same = TS_LOAD(A, i, j);
 		k = i;
 		same_flag = 1;
 	      }
 	    else
 	      {
-		B[j][i] = A[i][j];
+		TS_STORE(B, j, i, TS_LOAD(A, i, j));
 	      }
 	    
 	  }
 	if (same_flag)
-	  B[k][k] = same;
+	  TS_STORE(B, k, k, same);
 	same_flag = 0;
 	}
 }
@@ -82,17 +117,17 @@ void trans_uneven(int M, int N, int A[N][M], int B[M][N])
 	    // Keep checking for diags
 	    if (i == j)
 	      {
-		temp = A[i][j];
+		temp = TS_LOAD(A, i, j);
 		k = i;
 		temp_flag = 1;
 	      }
 	    else
 	      {
-		B[j][i] = A[i][j];
+		TS_STORE(B, j, i, TS_LOAD(A, i, j));
 	      }
 	  }
 	if (temp_flag)
-	  B[k][k] = temp;
+	  TS_STORE(B, k, k, temp);
 	temp_flag = 0;
 	}
 }
@@ -114,17 +149,17 @@ void trans2(int M, int N, int A[N][M], int B[M][N])
 	  {
 	    if (i == j)
 	      {
-		temp = A[i][j];
+		temp = TS_LOAD(A, i, j);
 		k = i;
 		temp_flag = 1;
 	      }
 	    else
 	      {
-		B[j][i] = A[i][j];
+		TS_STORE(B, j, i, TS_LOAD(A, i, j));
 	      }
 	  }
 	if (temp_flag)
-	  B[k][k] = temp;
+	  TS_STORE(B, k, k, temp);
 	temp_flag = 0;
 	}
 }
@@ -148,12 +183,119 @@ void trans_final(int M, int N, int A[N][M], int B[M][N])
 					}
 					else
 					{
-						B[j][i] = A[i][j];
+						TS_STORE(B, j, i, TS_LOAD(A, i, j));
 					}
 				}
 			}
 }
 
+/*
+ * co_split - Midpoint of [lo, hi), rounded up to a multiple of q (relative
+ *     to lo) so that tiles start on block boundaries where they can
+ */
+static int co_split(int lo, int hi, int q)
+{
+    int half = (hi - lo) / 2;
+    if (half >= q)
+        half = (half + q - 1) / q * q;
+    return lo + half;
+}
+
+/*
+ * co_transpose - Transposes rows [i0, i1) and columns [j0, j1) of A by
+ *     halving the longer side until the tile fits the base case. If simd
+ *     is set that is the SIMD kernels of transimd.h; otherwise it is at
+ *     most 8 rows by cols columns, each row segment read into locals
+ *     before being written to B.
+ */
+static void co_transpose(int M, int N, int A[N][M], int B[M][N],
+                         int i0, int i1, int j0, int j1, int cols, int simd)
+{
+    static const trans_sched_t base = { .diag = TS_BUFFER };
+    int mid;
+
+    if (simd && i1 - i0 <= CO_SIMD_LEAF && j1 - j0 <= CO_SIMD_LEAF) {
+        trans_simd_tile(M, N, A, B, i0, i1, j0, j1);
+    } else if (i1 - i0 <= CO_BASE && j1 - j0 <= cols) {
+        trans_sched_tile(M, N, A, B, &base, i0, i1, j0, j1);
+    } else if (i1 - i0 >= j1 - j0) {
+        mid = co_split(i0, i1, CO_BASE);
+        co_transpose(M, N, A, B, i0, mid, j0, j1, cols, simd);
+        co_transpose(M, N, A, B, mid, i1, j0, j1, cols, simd);
+    } else {
+        mid = co_split(j0, j1, cols);
+        co_transpose(M, N, A, B, i0, i1, j0, mid, cols, simd);
+        co_transpose(M, N, A, B, i0, i1, mid, j1, cols, simd);
+    }
+}
+
+/*
+ * trans_recursive - Cache-oblivious transpose for any M x N. When a row of
+ *     A or B is a multiple of 256 bytes, rows 8 apart share cache sets,
+ *     so the base case then takes 4 columns instead of 8. Scalar only, so
+ *     its trace is the same on every CPU.
+ */
+char trans_recursive_desc[] = "Recursive cache-oblivious transpose";
+void trans_recursive(int M, int N, int A[N][M], int B[M][N])
+{
+    int cols = (M % 64 == 0 || N % 64 == 0) ? CO_BASE / 2 : CO_BASE;
+    co_transpose(M, N, A, B, 0, N, 0, M, cols, 0);
+}
+
+/*
+ * trans_recursive_simd - trans_recursive with the SIMD kernels as its base
+ *     case where the CPU has them
+ */
+char trans_recursive_simd_desc[] = "Recursive cache-oblivious transpose (SIMD leaves)";
+void trans_recursive_simd(int M, int N, int A[N][M], int B[M][N])
+{
+    int cols = (M % 64 == 0 || N % 64 == 0) ? CO_BASE / 2 : CO_BASE;
+    co_transpose(M, N, A, B, 0, N, 0, M, cols,
+                 trans_simd_level() != SIMD_NONE);
+}
+
+/*
+ * trans_simd - 8x8 tiles in AVX2 registers (4x4 in SSE2 registers on
+ *     older CPUs), scalar copies at the edges
+ */
+char trans_simd_desc[] = "SIMD in-register tiles";
+void trans_simd(int M, int N, int A[N][M], int B[M][N])
+{
+    trans_simd_tile(M, N, A, B, 0, N, 0, M);
+}
+
+/*
+ * trans_streaming - SIMD tiles staged in a buffer and written to B a
+ *     whole line at a time with non-temporal stores, for matrices larger
+ *     than the last-level cache
+ */
+char trans_streaming_desc[] = "SIMD tiles, non-temporal stores";
+void trans_streaming(int M, int N, int A[N][M], int B[M][N])
+{
+    trans_stream(M, N, A, B);
+}
+
+/*
+ * trans_blocked_* - The buffered tile kernel for other element types, with
+ *     tiles cut to the graded cache's 32-byte blocks (8 ints, 4 doubles)
+ */
+TRANS_GENERIC(int, i)
+TRANS_GENERIC(int64_t, l)
+TRANS_GENERIC(float, f)
+TRANS_GENERIC(double, d)
+TRANS_GENERIC(trans_pair_t, pair)
+TRANS_GENERIC(trans_vec3_t, vec3)
+
+/*
+ * trans_blocked - The int kernel, reached through trans_generic so that
+ *     its dispatch on the element type is what gets graded
+ */
+char trans_blocked_desc[] = "Generic blocked (int)";
+void trans_blocked(int M, int N, int A[N][M], int B[M][N])
+{
+    trans_generic(M, N, A, B);
+}
+
 /*
  * transpose_submit - This is the solution transpose function that you
  *     will be graded on for Part B of the assignment. Do not change
@@ -164,6 +306,9 @@ void trans_final(int M, int N, int A[N][M], int B[M][N])
 char transpose_submit_desc[] = "Transpose submission";
 void transpose_submit(int M, int N, int A[N][M], int B[M][N])
 {
+    /* Only fixed code here: a schedule table would put its loads in the
+       graded trace, and its misses would depend on the trans.sched in the
+       directory. Tuned schedules run in trans_tuned. */
     if ((M == 32) && (N == 32))
       trans(M,N,A,B);
     else if ((M == 32) && (N == 64))
@@ -172,6 +317,41 @@ void transpose_submit(int M, int N, int A[N][M], int B[M][N])
       trans2(M,N,A,B);
     else if ((M == 61) && (N == 67))
       trans_final(M,N,A,B);
+    else
+      trans_recursive(M,N,A,B);
+}
+
+/*
+ * trans_tuned - Runs the tuned schedule, if there is one for this size
+ */
+char trans_tuned_desc[] = "Autotuned schedule (" SCHED_FILE ")";
+void trans_tuned(int M, int N, int A[N][M], int B[M][N])
+{
+    const trans_sched_t *sc = find_schedule(M, N);
+    if (sc != NULL)
+      trans_sched_run(M, N, A, B, sc);
+    else
+      transpose_submit(M, N, A, B);
+}
+
+/*
+ * load_schedules - Reads the entries of SCHED_FILE tuned for the graded
+ *     cache. This runs before any function is traced, so the file I/O
+ *     does not count against the transposes.
+ */
+static void load_schedules(void)
+{
+    char line[256];
+    FILE *fp = fopen(SCHED_FILE, "r");
+    if (fp == NULL)
+        return;
+    while (num_schedules < MAX_SCHEDS && fgets(line, sizeof(line), fp) != NULL)
+        if (trans_sched_read(line, &schedules[num_schedules]) &&
+            schedules[num_schedules].s == GRADED_S &&
+            schedules[num_schedules].E == GRADED_E &&
+            schedules[num_schedules].b == GRADED_B)
+            num_schedules++;
+    fclose(fp);
 }
 
 /*
@@ -183,6 +363,8 @@ void transpose_submit(int M, int N, int A[N][M], int B[M][N])
  */
 void registerFunctions()
 {
+    load_schedules();
+
     /* Register your solution function */
     registerTransFunction(transpose_submit, transpose_submit_desc);
 
@@ -197,6 +379,28 @@ void registerFunctions()
 
     /* 61x67 Solution */
     registerTransFunction(trans_final, trans_final_desc);
+
+    /* Any size */
+    registerTransFunction(trans_recursive, trans_recursive_desc);
+    registerTransFunction(trans_recursive_simd, trans_recursive_simd_desc);
+
+    /* Vector registers */
+    registerTransFunction(trans_simd, trans_simd_desc);
+
+    /* Stores that bypass the cache */
+    registerTransFunction(trans_streaming, trans_streaming_desc);
+
+    /* The same kernel for any element type */
+    registerTransFunction(trans_blocked, trans_blocked_desc);
+    registerTransGeneric(trans_blocked_l_v, sizeof(int64_t), trans_blocked_l_desc);
+    registerTransGeneric(trans_blocked_f_v, sizeof(float), trans_blocked_f_desc);
+    registerTransGeneric(trans_blocked_d_v, sizeof(double), trans_blocked_d_desc);
+    registerTransGeneric(trans_blocked_pair_v, sizeof(trans_pair_t), trans_blocked_pair_desc);
+    registerTransGeneric(trans_blocked_vec3_v, sizeof(trans_vec3_t), trans_blocked_vec3_desc);
+
+    /* Schedules found by transtune */
+    if (num_schedules > 0)
+        registerTransFunction(trans_tuned, trans_tuned_desc);
 }
 
 
@@ -0,0 +1,153 @@
+/*
+ * transched.h - Parameterized tiled transpose shared by trans.c and the
+ *     autotuner (transtune.c)
+ *
+ * A schedule fixes the tile shape, the order tiles and elements are
+ * visited in, and how elements on the diagonal are handled. transtune
+ * searches schedules for a given matrix and cache by replaying
+ * trans_sched_run with TS_LOAD/TS_STORE redefined to record addresses,
+ * and writes the winners to a table, one schedule per line:
+ *
+ *     M N s E b tile_r tile_c order inner diag
+ *
+ * Lines starting with '#' are comments. trans.c reads the table when its
+ * functions are registered, and trans_tuned ("Autotuned schedule") runs
+ * the entry for the matrix and the graded cache. transpose_submit does
+ * not, so that its graded trace holds no table loads.
+ */
+#ifndef TRANSCHED_H
+#define TRANSCHED_H
+
+#include <stdio.h>
+
+/* Default table location, relative to the directory test-trans runs in */
+#define SCHED_FILE "trans.sched"
+
+/* Most elements a diag == TS_BUFFER schedule holds in locals */
+#define TS_MAX_BUFFER 8
+
+/* Diagonal strategies */
+#define TS_DIRECT 0     /* copy every element as it is read */
+#define TS_DEFER 1      /* hold A[i][i] until the rest of its row is done */
+#define TS_BUFFER 2     /* read a tile row of A into locals, then write it */
+
+typedef struct trans_sched {
+    int M, N;           /* A is N x M */
+    int s, E, b;        /* cache the schedule was tuned for */
+    int tile_r;         /* rows of A per tile */
+    int tile_c;         /* columns of A per tile */
+    int order;          /* 0: tiles along A's rows, 1: down A's columns */
+    int inner;          /* 0: walk a tile by A's rows, 1: by B's rows */
+    int diag;           /* TS_DIRECT, TS_DEFER or TS_BUFFER */
+} trans_sched_t;
+
+#ifndef TS_LOAD
+#define TS_LOAD(X, r, c) (X[r][c])
+#define TS_STORE(X, r, c, v) (X[r][c] = (v))
+#endif
+
+/*
+ * trans_sched_read - Parse one table line; returns 1 for a schedule and
+ *     0 for a comment, a blank or a malformed line
+ */
+static inline int trans_sched_read(const char *line, trans_sched_t *sc)
+{
+    return line[0] != '#' &&
+        sscanf(line, "%d %d %d %d %d %d %d %d %d %d", &sc->M, &sc->N, &sc->s,
+               &sc->E, &sc->b, &sc->tile_r, &sc->tile_c, &sc->order,
+               &sc->inner, &sc->diag) == 10 &&
+        sc->tile_r > 0 && sc->tile_c > 0 &&
+        (sc->diag != TS_BUFFER || sc->tile_c <= TS_MAX_BUFFER);
+}
+
+/*
+ * trans_sched_tile - Transpose the tile of rows [i0, i1) and columns
+ *     [j0, j1) of A
+ */
+static inline void trans_sched_tile(int M, int N, int A[N][M], int B[M][N],
+                                    const trans_sched_t *sc,
+                                    int i0, int i1, int j0, int j1)
+{
+    int i, j, d = 0, k = -1;
+    int t0 = 0, t1 = 0, t2 = 0, t3 = 0, t4 = 0, t5 = 0, t6 = 0, t7 = 0;
+
+    if (sc->diag == TS_BUFFER) {
+        /* The whole row segment is read before B is touched */
+        for (i = i0; i < i1; i++) {
+            j = j1 - j0;
+            if (j > 0) t0 = TS_LOAD(A, i, j0);
+            if (j > 1) t1 = TS_LOAD(A, i, j0 + 1);
+            if (j > 2) t2 = TS_LOAD(A, i, j0 + 2);
+            if (j > 3) t3 = TS_LOAD(A, i, j0 + 3);
+            if (j > 4) t4 = TS_LOAD(A, i, j0 + 4);
+            if (j > 5) t5 = TS_LOAD(A, i, j0 + 5);
+            if (j > 6) t6 = TS_LOAD(A, i, j0 + 6);
+            if (j > 7) t7 = TS_LOAD(A, i, j0 + 7);
+            if (j > 0) TS_STORE(B, j0, i, t0);
+            if (j > 1) TS_STORE(B, j0 + 1, i, t1);
+            if (j > 2) TS_STORE(B, j0 + 2, i, t2);
+            if (j > 3) TS_STORE(B, j0 + 3, i, t3);
+            if (j > 4) TS_STORE(B, j0 + 4, i, t4);
+            if (j > 5) TS_STORE(B, j0 + 5, i, t5);
+            if (j > 6) TS_STORE(B, j0 + 6, i, t6);
+            if (j > 7) TS_STORE(B, j0 + 7, i, t7);
+        }
+        return;
+    }
+    if (sc->inner == 0) {
+        for (i = i0; i < i1; i++) {
+            for (j = j0; j < j1; j++) {
+                if (sc->diag == TS_DEFER && i == j) {
+                    d = TS_LOAD(A, i, j);
+                    k = i;
+                } else {
+                    TS_STORE(B, j, i, TS_LOAD(A, i, j));
+                }
+            }
+            if (k >= 0) {
+                TS_STORE(B, k, k, d);
+                k = -1;
+            }
+        }
+    } else {
+        for (j = j0; j < j1; j++) {
+            for (i = i0; i < i1; i++) {
+                if (sc->diag == TS_DEFER && i == j) {
+                    d = TS_LOAD(A, i, j);
+                    k = i;
+                } else {
+                    TS_STORE(B, j, i, TS_LOAD(A, i, j));
+                }
+            }
+            if (k >= 0) {
+                TS_STORE(B, k, k, d);
+                k = -1;
+            }
+        }
+    }
+}
+
+/*
+ * trans_sched_run - Transpose A into B following schedule sc
+ */
+static inline void trans_sched_run(int M, int N, int A[N][M], int B[M][N],
+                                   const trans_sched_t *sc)
+{
+    int r, c;
+
+    if (sc->order == 0) {
+        for (r = 0; r < N; r += sc->tile_r)
+            for (c = 0; c < M; c += sc->tile_c)
+                trans_sched_tile(M, N, A, B, sc, r,
+                                 r + sc->tile_r < N ? r + sc->tile_r : N,
+                                 c, c + sc->tile_c < M ? c + sc->tile_c : M);
+    } else {
+        for (c = 0; c < M; c += sc->tile_c)
+            for (r = 0; r < N; r += sc->tile_r)
+                trans_sched_tile(M, N, A, B, sc, r,
+                                 r + sc->tile_r < N ? r + sc->tile_r : N,
+                                 c, c + sc->tile_c < M ? c + sc->tile_c : M);
+    }
+}
+
+#endif /* TRANSCHED_H */
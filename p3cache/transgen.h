@@ -0,0 +1,125 @@
+/*
+ * transgen.h - Blocked transpose for any element type
+ *
+ * TRANS_GENERIC(T, sfx) defines, for an N x M matrix of T,
+ *
+ *     void trans_blocked_sfx(int M, int N, T A[N][M], T B[M][N]);
+ *     void trans_blocked_sfx_v(int M, int N, void *A, void *B);
+ *     char trans_blocked_sfx_desc[];
+ *
+ * The second form is the one registerTransGeneric takes. The kernel is
+ * the one trans.c's int functions are built from: each row segment of a
+ * tile is read into locals before any of it is written to B, so the
+ * diagonal of A and B never evict each other mid-row. The tile is not
+ * fixed at 8 but worked out from the element size: as many elements as
+ * fill a TG_LINE-byte line, cut down when rows of A (or B) that many
+ * apart fall in the same set of a cache whose sets repeat every TG_SPAN
+ * bytes. Both default to the graded cache.
+ *
+ * The types trans.c instantiates are declared below, and
+ * trans_generic(M, N, A, B) picks the one for A's element type.
+ *
+ * Matrix accesses go through TG_LOAD/TG_STORE, which tracegen-native
+ * records and which otherwise cost nothing.
+ */
+#ifndef TRANSGEN_H
+#define TRANSGEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Line size and set span the tiles are cut for */
+#ifndef TG_LINE
+#define TG_LINE 32
+#endif
+#ifndef TG_SPAN
+#define TG_SPAN 1024
+#endif
+
+/* Longest tile edge: a 64-byte line of 4-byte elements */
+#define TG_MAX_TILE 16
+
+#ifndef TG_LOAD
+#define TG_LOAD(X, r, c) (X[r][c])
+#define TG_STORE(X, r, c, v) (X[r][c] = (v))
+#endif
+
+/* Fixed-size records trans.c instantiates the kernel for */
+typedef struct { double re, im; } trans_pair_t;        /* 16 bytes */
+typedef struct { float x, y, z; } trans_vec3_t;        /* 12 bytes */
+
+/*
+ * tg_tile - Tile edge for elements of size bytes in rows row_bytes long
+ */
+static inline int tg_tile(size_t size, long row_bytes)
+{
+    long a = row_bytes % TG_SPAN, b = TG_SPAN, t;
+    int tile = size < TG_LINE ? (int)(TG_LINE / size) : 1;
+
+    if (tile > TG_MAX_TILE)
+        tile = TG_MAX_TILE;
+    /* Rows TG_SPAN / gcd(row_bytes, TG_SPAN) apart share a set */
+    while (a != 0) {
+        t = b % a;
+        b = a;
+        a = t;
+    }
+    if (tile > TG_SPAN / b)
+        tile = TG_SPAN / b;
+    return tile;
+}
+
+#define TRANS_GENERIC(T, sfx)                                               \
+static void tg_tile_##sfx(int M, int N, T A[N][M], T B[M][N],               \
+                          int i0, int i1, int j0, int j1)                   \
+{                                                                           \
+    T t[TG_MAX_TILE];                                                       \
+    int i, j;                                                               \
+                                                                            \
+    for (i = i0; i < i1; i++) {                                             \
+        for (j = j0; j < j1; j++)                                           \
+            t[j - j0] = TG_LOAD(A, i, j);                                   \
+        for (j = j0; j < j1; j++)                                           \
+            TG_STORE(B, j, i, t[j - j0]);                                   \
+    }                                                                       \
+}                                                                           \
+                                                                            \
+char trans_blocked_##sfx##_desc[] = "Generic blocked (" #T ")";             \
+void trans_blocked_##sfx(int M, int N, T A[N][M], T B[M][N])                \
+{                                                                           \
+    int tr = tg_tile(sizeof(T), (long)M * sizeof(T));                       \
+    int tc = tg_tile(sizeof(T), (long)N * sizeof(T));                       \
+    int r, c;                                                               \
+                                                                            \
+    for (r = 0; r < N; r += tr)                                             \
+        for (c = 0; c < M; c += tc)                                         \
+            tg_tile_##sfx(M, N, A, B, r, r + tr < N ? r + tr : N,           \
+                          c, c + tc < M ? c + tc : M);                      \
+}                                                                           \
+                                                                            \
+void trans_blocked_##sfx##_v(int M, int N, void *A, void *B)                \
+{                                                                           \
+    trans_blocked_##sfx(M, N, (T (*)[M])A, (T (*)[N])B);                    \
+}
+
+#define TRANS_GENERIC_DECLARE(T, sfx)                                       \
+extern char trans_blocked_##sfx##_desc[];                                   \
+void trans_blocked_##sfx(int M, int N, T A[N][M], T B[M][N]);               \
+void trans_blocked_##sfx##_v(int M, int N, void *A, void *B);
+
+TRANS_GENERIC_DECLARE(int, i)
+TRANS_GENERIC_DECLARE(int64_t, l)
+TRANS_GENERIC_DECLARE(float, f)
+TRANS_GENERIC_DECLARE(double, d)
+TRANS_GENERIC_DECLARE(trans_pair_t, pair)
+TRANS_GENERIC_DECLARE(trans_vec3_t, vec3)
+
+#define trans_generic(M, N, A, B) _Generic((A)[0][0],                       \
+    int: trans_blocked_i,                                                   \
+    int64_t: trans_blocked_l,                                               \
+    float: trans_blocked_f,                                                 \
+    double: trans_blocked_d,                                                \
+    trans_pair_t: trans_blocked_pair,                                       \
+    trans_vec3_t: trans_blocked_vec3)(M, N, A, B)
+
+#endif /* TRANSGEN_H */
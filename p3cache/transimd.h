@@ -0,0 +1,341 @@
+/*
+ * transimd.h - In-register transpose kernels for trans.c
+ *
+ * An 8x8 tile of ints is loaded into eight AVX2 registers, or a 4x4 tile
+ * into four SSE2 registers, transposed with unpack and lane-permute
+ * steps, and written back to B as whole rows. trans_simd_tile covers a
+ * tile with the widest kernel the CPU supports, narrower kernels on the
+ * edges that are left and scalar copies for the rest. The CPU is asked
+ * once, through __builtin_cpu_supports, and each kernel is compiled for
+ * its own target, so the rest of trans.c keeps the default flags.
+ *
+ * trans_stream writes B with non-temporal stores instead, for matrices
+ * too large for the last-level cache: a 16x16 tile is transposed into an
+ * aligned buffer that stays in L1, and each of its rows, a whole 64-byte
+ * line of B, is streamed past the cache. That saves both the read for
+ * ownership of every line of B and the lines of A it would have evicted.
+ *
+ * On other architectures only the scalar path is built.
+ *
+ * TS_VROWS(op, X, r, c, rows, size) is called for each group of vector
+ * loads or stores (rows rows of X from (r, c), size bytes each), and the
+ * scalar edges go through TS_LOAD/TS_STORE; tracegen-native records
+ * them, and by default they cost nothing.
+ */
+#ifndef TRANSIMD_H
+#define TRANSIMD_H
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TRANS_SIMD 1
+#include <immintrin.h>
+#else
+#define TRANS_SIMD 0
+#endif
+
+#ifndef TS_LOAD
+#define TS_LOAD(X, r, c) (X[r][c])
+#define TS_STORE(X, r, c, v) (X[r][c] = (v))
+#endif
+
+#ifndef TS_VROWS
+#define TS_VROWS(op, X, r, c, rows, size) ((void)0)
+#endif
+
+/* Kernel widths returned by trans_simd_level */
+#define SIMD_NONE 0
+#define SIMD_SSE2 4
+#define SIMD_AVX2 8
+
+/* Edge of a trans_stream tile: one 64-byte line of ints */
+#define STREAM_TILE 16
+
+#if TRANS_SIMD
+/*
+ * sse2_4x4 - Transposes the 4x4 block at a, whose rows are as ints
+ *     apart, into b, whose rows are bs ints apart
+ */
+__attribute__((target("sse2")))
+static inline void sse2_4x4(const int *a, long as, int *b, long bs)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i*)a);
+    __m128i r1 = _mm_loadu_si128((const __m128i*)(a + as));
+    __m128i r2 = _mm_loadu_si128((const __m128i*)(a + 2 * as));
+    __m128i r3 = _mm_loadu_si128((const __m128i*)(a + 3 * as));
+
+    /* Interleave pairs of rows, then pairs of pairs */
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+    _mm_storeu_si128((__m128i*)b, _mm_unpacklo_epi64(t0, t1));
+    _mm_storeu_si128((__m128i*)(b + bs), _mm_unpackhi_epi64(t0, t1));
+    _mm_storeu_si128((__m128i*)(b + 2 * bs), _mm_unpacklo_epi64(t2, t3));
+    _mm_storeu_si128((__m128i*)(b + 3 * bs), _mm_unpackhi_epi64(t2, t3));
+}
+
+/*
+ * trans_sse2_4x4 - Transposes the 4x4 tile of A at (i, j) into B
+ */
+__attribute__((target("sse2")))
+static inline void trans_sse2_4x4(int M, int N, int A[N][M], int B[M][N],
+                                  int i, int j)
+{
+    TS_VROWS('L', A, i, j, 4, 16);
+    sse2_4x4(&A[i][j], M, &B[j][i], N);
+    TS_VROWS('S', B, j, i, 4, 16);
+}
+
+/*
+ * avx2_8x8 - sse2_4x4 for an 8x8 block
+ */
+__attribute__((target("avx2")))
+static inline void avx2_8x8(const int *a, long as, int *b, long bs)
+{
+    __m256i r0 = _mm256_loadu_si256((const __m256i*)a);
+    __m256i r1 = _mm256_loadu_si256((const __m256i*)(a + as));
+    __m256i r2 = _mm256_loadu_si256((const __m256i*)(a + 2 * as));
+    __m256i r3 = _mm256_loadu_si256((const __m256i*)(a + 3 * as));
+    __m256i r4 = _mm256_loadu_si256((const __m256i*)(a + 4 * as));
+    __m256i r5 = _mm256_loadu_si256((const __m256i*)(a + 5 * as));
+    __m256i r6 = _mm256_loadu_si256((const __m256i*)(a + 6 * as));
+    __m256i r7 = _mm256_loadu_si256((const __m256i*)(a + 7 * as));
+
+    /* Each 128-bit lane holds a 4x4 transpose after these two steps */
+    __m256i t0 = _mm256_unpacklo_epi32(r0, r1);
+    __m256i t1 = _mm256_unpackhi_epi32(r0, r1);
+    __m256i t2 = _mm256_unpacklo_epi32(r2, r3);
+    __m256i t3 = _mm256_unpackhi_epi32(r2, r3);
+    __m256i t4 = _mm256_unpacklo_epi32(r4, r5);
+    __m256i t5 = _mm256_unpackhi_epi32(r4, r5);
+    __m256i t6 = _mm256_unpacklo_epi32(r6, r7);
+    __m256i t7 = _mm256_unpackhi_epi32(r6, r7);
+
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    /* Low lanes hold columns 0-3, high lanes columns 4-7 */
+    _mm256_storeu_si256((__m256i*)b, _mm256_permute2x128_si256(u0, u4, 0x20));
+    _mm256_storeu_si256((__m256i*)(b + bs), _mm256_permute2x128_si256(u1, u5, 0x20));
+    _mm256_storeu_si256((__m256i*)(b + 2 * bs), _mm256_permute2x128_si256(u2, u6, 0x20));
+    _mm256_storeu_si256((__m256i*)(b + 3 * bs), _mm256_permute2x128_si256(u3, u7, 0x20));
+    _mm256_storeu_si256((__m256i*)(b + 4 * bs), _mm256_permute2x128_si256(u0, u4, 0x31));
+    _mm256_storeu_si256((__m256i*)(b + 5 * bs), _mm256_permute2x128_si256(u1, u5, 0x31));
+    _mm256_storeu_si256((__m256i*)(b + 6 * bs), _mm256_permute2x128_si256(u2, u6, 0x31));
+    _mm256_storeu_si256((__m256i*)(b + 7 * bs), _mm256_permute2x128_si256(u3, u7, 0x31));
+}
+
+/*
+ * trans_avx2_8x8 - Transposes the 8x8 tile of A at (i, j) into B
+ */
+__attribute__((target("avx2")))
+static inline void trans_avx2_8x8(int M, int N, int A[N][M], int B[M][N],
+                                  int i, int j)
+{
+    TS_VROWS('L', A, i, j, 8, 32);
+    avx2_8x8(&A[i][j], M, &B[j][i], N);
+    TS_VROWS('S', B, j, i, 8, 32);
+}
+
+/*
+ * trans_stream_sse2 - Transposes the 16x16 tile of A at (i, j) into an
+ *     aligned buffer, then copies each row of the buffer to B, with
+ *     non-temporal stores if nt; B's rows must start on 16-byte boundaries
+ */
+__attribute__((target("sse2")))
+static inline void trans_stream_sse2(int M, int N, int A[N][M], int B[M][N],
+                                     int i, int j, int nt)
+{
+    __m128i v;
+    int buf[STREAM_TILE][STREAM_TILE] __attribute__((aligned(64)));
+    int r, c;
+
+    for (r = 0; r < STREAM_TILE; r += 4)
+        for (c = 0; c < STREAM_TILE; c += 4) {
+            TS_VROWS('L', A, i + r, j + c, 4, 16);
+            sse2_4x4(&A[i + r][j + c], M, &buf[c][r], STREAM_TILE);
+        }
+    for (c = 0; c < STREAM_TILE; c++)
+        for (r = 0; r < STREAM_TILE; r += 4) {
+            v = _mm_load_si128((const __m128i*)&buf[c][r]);
+            if (nt)
+                _mm_stream_si128((__m128i*)&B[j + c][i + r], v);
+            else
+                _mm_store_si128((__m128i*)&B[j + c][i + r], v);
+            TS_VROWS('S', B, j + c, i + r, 1, 16);
+        }
+}
+
+/*
+ * trans_stream_avx2 - trans_stream_sse2 with 8x8 kernels and 32-byte
+ *     stores; B's rows must start on 32-byte boundaries
+ */
+__attribute__((target("avx2")))
+static inline void trans_stream_avx2(int M, int N, int A[N][M], int B[M][N],
+                                     int i, int j, int nt)
+{
+    __m256i v0, v1;
+    int buf[STREAM_TILE][STREAM_TILE] __attribute__((aligned(64)));
+    int r, c;
+
+    for (r = 0; r < STREAM_TILE; r += 8)
+        for (c = 0; c < STREAM_TILE; c += 8) {
+            TS_VROWS('L', A, i + r, j + c, 8, 32);
+            avx2_8x8(&A[i + r][j + c], M, &buf[c][r], STREAM_TILE);
+        }
+    for (c = 0; c < STREAM_TILE; c++) {
+        v0 = _mm256_load_si256((const __m256i*)&buf[c][0]);
+        v1 = _mm256_load_si256((const __m256i*)&buf[c][8]);
+        if (nt) {
+            _mm256_stream_si256((__m256i*)&B[j + c][i], v0);
+            _mm256_stream_si256((__m256i*)&B[j + c][i + 8], v1);
+        } else {
+            _mm256_store_si256((__m256i*)&B[j + c][i], v0);
+            _mm256_store_si256((__m256i*)&B[j + c][i + 8], v1);
+        }
+        TS_VROWS('S', B, j + c, i, 1, 32);
+        TS_VROWS('S', B, j + c, i + 8, 1, 32);
+    }
+}
+
+/*
+ * stream_fence - Orders the streaming stores before any later store, so
+ *     whoever reads B next sees them
+ */
+__attribute__((target("sse2")))
+static inline void stream_fence(void)
+{
+    _mm_sfence();
+}
+#endif
+
+/*
+ * trans_simd_level - Widest kernel this CPU runs: SIMD_AVX2, SIMD_SSE2 or
+ *     SIMD_NONE
+ */
+static inline int trans_simd_level(void)
+{
+    static int level = -1;
+
+    if (level < 0) {
+#if TRANS_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            level = SIMD_AVX2;
+        else if (__builtin_cpu_supports("sse2"))
+            level = SIMD_SSE2;
+        else
+#endif
+            level = SIMD_NONE;
+    }
+    return level;
+}
+
+/*
+ * trans_simd_rect - Transposes rows [i0, i1) and columns [j0, j1) of A
+ *     with width x width kernels where they fit; the strips left over go
+ *     to the next narrower kernel
+ */
+static inline void trans_simd_rect(int M, int N, int A[N][M], int B[M][N],
+                                   int i0, int i1, int j0, int j1, int width)
+{
+    int i, j, ie = i0, je = j0;
+
+#if TRANS_SIMD
+    if (width != SIMD_NONE) {
+        ie = i0 + (i1 - i0) / width * width;
+        je = j0 + (j1 - j0) / width * width;
+        for (i = i0; i < ie; i += width)
+            for (j = j0; j < je; j += width) {
+                if (width == SIMD_AVX2)
+                    trans_avx2_8x8(M, N, A, B, i, j);
+                else
+                    trans_sse2_4x4(M, N, A, B, i, j);
+            }
+        if (width == SIMD_AVX2) {
+            trans_simd_rect(M, N, A, B, i0, ie, je, j1, SIMD_SSE2);
+            trans_simd_rect(M, N, A, B, ie, i1, j0, j1, SIMD_SSE2);
+            return;
+        }
+    }
+#endif
+    /* Scalar edges: the columns right of the kernels, then the rows below */
+    for (i = i0; i < ie; i++)
+        for (j = je; j < j1; j++)
+            TS_STORE(B, j, i, TS_LOAD(A, i, j));
+    for (i = ie; i < i1; i++)
+        for (j = j0; j < j1; j++)
+            TS_STORE(B, j, i, TS_LOAD(A, i, j));
+}
+
+/*
+ * trans_simd_tile - Transposes rows [i0, i1) and columns [j0, j1) of A
+ *     with the widest kernels available
+ */
+static inline void trans_simd_tile(int M, int N, int A[N][M], int B[M][N],
+                                   int i0, int i1, int j0, int j1)
+{
+    trans_simd_rect(M, N, A, B, i0, i1, j0, j1, trans_simd_level());
+}
+
+/*
+ * trans_stream_ok - Whether trans_stream can stream into B: every row must
+ *     start on a line, so that each STREAM_TILE-int segment fills one
+ */
+static inline int trans_stream_ok(int N, const void *B)
+{
+    return trans_simd_level() != SIMD_NONE && N % STREAM_TILE == 0 &&
+        (uintptr_t)B % (STREAM_TILE * sizeof(int)) == 0;
+}
+
+/*
+ * trans_staged - Transposes A into B in bands of 16 rows of A, each a
+ *     16-int segment of B's rows, which trans_stream_ok makes a whole
+ *     line (B 64-byte aligned, N a multiple of 16). Tiles are staged in a buffer and written
+ *     with non-temporal stores if nt, with ordinary aligned stores if
+ *     not; edges that do not fill a tile always use ordinary stores. If
+ *     trans_stream_ok fails, it is trans_simd_tile.
+ */
+static inline void trans_staged(int M, int N, int A[N][M], int B[M][N], int nt)
+{
+    int level = trans_simd_level();
+#if TRANS_SIMD
+    int ie = N / STREAM_TILE * STREAM_TILE, je = M / STREAM_TILE * STREAM_TILE;
+    int i, j;
+
+    if (trans_stream_ok(N, &B[0][0])) {
+        for (i = 0; i < ie; i += STREAM_TILE) {
+            for (j = 0; j < je; j += STREAM_TILE) {
+                if (level == SIMD_AVX2)
+                    trans_stream_avx2(M, N, A, B, i, j, nt);
+                else
+                    trans_stream_sse2(M, N, A, B, i, j, nt);
+            }
+            trans_simd_rect(M, N, A, B, i, i + STREAM_TILE, je, M, level);
+        }
+        trans_simd_rect(M, N, A, B, ie, N, 0, M, level);
+        if (nt)
+            stream_fence();
+        return;
+    }
+#endif
+    trans_simd_rect(M, N, A, B, 0, N, 0, M, level);
+}
+
+/*
+ * trans_stream - trans_staged with non-temporal stores
+ */
+static inline void trans_stream(int M, int N, int A[N][M], int B[M][N])
+{
+    trans_staged(M, N, A, B, 1);
+}
+
+#endif /* TRANSIMD_H */
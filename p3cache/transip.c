@@ -0,0 +1,89 @@
+/*
+ * transip.c - In-place transposes
+ *
+ * Square matrices are cut into TI_TILE x TI_TILE tiles. A tile on the
+ * diagonal is transposed by swapping across its own diagonal; every
+ * other tile is swapped element by element with its mirror image, so
+ * each pass reads and writes two tiles that both stay in the cache.
+ *
+ * For M != N, element k = i*M + j of the N x M matrix belongs at
+ * j*N + i = k*N mod (MN - 1), and the elements fall into cycles of that
+ * permutation. Each cycle is walked once, carrying one element at a
+ * time; a bit per position records which have been placed so cycles are
+ * not walked twice. The accesses jump around the whole matrix, so this
+ * is much slower than the square case: the price of not doubling memory.
+ */
+#include <stdlib.h>
+#include "transip.h"
+
+/* Tile edge for the square case: two 32x32 int tiles are 8KB */
+#define TI_TILE 32
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+void trans_inplace_square(int N, int A[N][N])
+{
+    int r, c, i, j, ie, je, t;
+
+    for (r = 0; r < N; r += TI_TILE) {
+        ie = MIN(r + TI_TILE, N);
+        /* The diagonal tile, above its diagonal swapped with below */
+        for (i = r; i < ie; i++)
+            for (j = i + 1; j < ie; j++) {
+                t = A[i][j];
+                A[i][j] = A[j][i];
+                A[j][i] = t;
+            }
+        /* Tiles right of the diagonal with their mirrors below it */
+        for (c = r + TI_TILE; c < N; c += TI_TILE) {
+            je = MIN(c + TI_TILE, N);
+            for (i = r; i < ie; i++)
+                for (j = c; j < je; j++) {
+                    t = A[i][j];
+                    A[i][j] = A[j][i];
+                    A[j][i] = t;
+                }
+        }
+    }
+}
+
+size_t trans_inplace_extra(int M, int N)
+{
+    if (M == N || M == 1 || N == 1)
+        return 0;
+    return ((size_t)M * N + 7) / 8;
+}
+
+int trans_inplace(int M, int N, int *A)
+{
+    unsigned long long last = (unsigned long long)M * N - 1, k, cur;
+    unsigned char *placed;
+    int v, t;
+
+    if (M == N) {
+        trans_inplace_square(N, (int (*)[N])A);
+        return 0;
+    }
+    /* A single row or column is laid out the same way as its transpose */
+    if (M == 1 || N == 1)
+        return 0;
+    if ((placed = (unsigned char*)calloc(trans_inplace_extra(M, N), 1)) == NULL)
+        return -1;
+
+    /* Positions 0 and MN - 1 never move */
+    for (k = 1; k < last; k++) {
+        if (placed[k >> 3] & (1 << (k & 7)))
+            continue;
+        v = A[k];
+        cur = k;
+        do {
+            cur = cur * N % last;
+            t = A[cur];
+            A[cur] = v;
+            v = t;
+            placed[cur >> 3] |= 1 << (cur & 7);
+        } while (cur != k);
+    }
+    free(placed);
+    return 0;
+}
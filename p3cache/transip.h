@@ -0,0 +1,30 @@
+/*
+ * transip.h - In-place transposes, for matrices too large to hold twice
+ *
+ * A holds an N x M matrix, row by row; afterwards it holds the M x N
+ * transpose in the same memory. Square matrices need no extra memory;
+ * other shapes need one bit per element.
+ */
+#ifndef TRANSIP_H
+#define TRANSIP_H
+
+#include <stddef.h>
+
+/*
+ * trans_inplace_square - Transpose the N x N matrix A in place by
+ *     swapping tiles across the diagonal
+ */
+void trans_inplace_square(int N, int A[N][N]);
+
+/*
+ * trans_inplace - Transpose the N x M matrix in A in place; returns 0, or
+ *     -1 if the bit vector for a rectangular matrix cannot be allocated
+ */
+int trans_inplace(int M, int N, int *A);
+
+/*
+ * trans_inplace_extra - Bytes of working memory trans_inplace needs
+ */
+size_t trans_inplace_extra(int M, int N);
+
+#endif /* TRANSIP_H */
@@ -0,0 +1,146 @@
+/*
+ * transpar.c - Thread pool for transposing large matrices
+ *
+ * A is cut into bands of TP_BAND rows. A band of A is a band of columns
+ * of B, so as long as B's rows start on cache lines (N a multiple of 16
+ * and B 64-byte aligned) no two threads write the same line of B; for
+ * other widths only the line straddling each band edge is shared. Bands
+ * are handed out one at a time from an atomic counter, so a thread that
+ * is slowed down simply takes fewer of them. Inside a band, tiles of
+ * TP_TILE columns go through the SIMD kernels of transimd.h.
+ */
+#include <stdlib.h>
+#include <pthread.h>
+#include "transpar.h"
+#include "transimd.h"
+
+/* Rows of A per band; in each row of B that is four 64-byte lines */
+#define TP_BAND 64
+
+/* Columns of A per tile within a band */
+#define TP_TILE 32
+
+struct trans_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t start;       /* a new job is posted, or quit */
+    pthread_cond_t done;        /* the last worker left the job */
+    pthread_t *workers;
+    int threads;                /* workers + the caller */
+    unsigned long job;          /* bumped for every call */
+    int busy;                   /* workers still in the current job */
+    int quit;
+
+    /* The current job */
+    int M, N;
+    int *A, *B;
+    int bands;
+    int next;                   /* next band to take */
+};
+
+/*
+ * do_bands - Transpose bands of the current job until there are none left
+ */
+static void do_bands(trans_pool_t *p)
+{
+    int M = p->M, N = p->N;
+    int (*A)[M] = (int (*)[M])p->A;
+    int (*B)[N] = (int (*)[N])p->B;
+    int band, i0, i1, j;
+
+    while ((band = __atomic_fetch_add(&p->next, 1, __ATOMIC_RELAXED)) < p->bands) {
+        i0 = band * TP_BAND;
+        i1 = i0 + TP_BAND < N ? i0 + TP_BAND : N;
+        for (j = 0; j < M; j += TP_TILE)
+            trans_simd_tile(M, N, A, B, i0, i1, j, j + TP_TILE < M ? j + TP_TILE : M);
+    }
+}
+
+static void *worker(void *arg)
+{
+    trans_pool_t *p = (trans_pool_t*)arg;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (p->job == seen && !p->quit)
+            pthread_cond_wait(&p->start, &p->lock);
+        if (p->quit)
+            break;
+        seen = p->job;
+        pthread_mutex_unlock(&p->lock);
+        do_bands(p);
+        pthread_mutex_lock(&p->lock);
+        if (--p->busy == 0)
+            pthread_cond_signal(&p->done);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+trans_pool_t *trans_pool_create(int threads)
+{
+    trans_pool_t *p = (trans_pool_t*)calloc(1, sizeof(trans_pool_t));
+    int i;
+
+    if (p == NULL || threads < 1)
+        goto fail;
+    p->threads = threads;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->start, NULL);
+    pthread_cond_init(&p->done, NULL);
+    if ((p->workers = (pthread_t*)calloc(threads, sizeof(pthread_t))) == NULL)
+        goto fail;
+    /* The caller is the first thread, so threads - 1 workers */
+    for (i = 1; i < threads; i++)
+        if (pthread_create(&p->workers[i], NULL, worker, p) != 0) {
+            p->threads = i;
+            trans_pool_destroy(p);
+            return NULL;
+        }
+    return p;
+
+fail:
+    if (p != NULL)
+        free(p->workers);
+    free(p);
+    return NULL;
+}
+
+void trans_pool_run(trans_pool_t *p, int M, int N, int A[N][M], int B[M][N])
+{
+    pthread_mutex_lock(&p->lock);
+    p->M = M;
+    p->N = N;
+    p->A = &A[0][0];
+    p->B = &B[0][0];
+    p->bands = (N + TP_BAND - 1) / TP_BAND;
+    p->next = 0;
+    p->busy = p->threads - 1;
+    p->job++;
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->lock);
+
+    do_bands(p);
+
+    pthread_mutex_lock(&p->lock);
+    while (p->busy > 0)
+        pthread_cond_wait(&p->done, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void trans_pool_destroy(trans_pool_t *p)
+{
+    int i;
+
+    pthread_mutex_lock(&p->lock);
+    p->quit = 1;
+    pthread_cond_broadcast(&p->start);
+    pthread_mutex_unlock(&p->lock);
+    for (i = 1; i < p->threads; i++)
+        pthread_join(p->workers[i], NULL);
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->start);
+    pthread_cond_destroy(&p->done);
+    free(p->workers);
+    free(p);
+}
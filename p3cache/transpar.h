@@ -0,0 +1,32 @@
+/*
+ * transpar.h - Multi-threaded tiled transpose for large matrices
+ *
+ * The matrices test-trans grades fit in tracegen's 256x256 arrays and
+ * are traced on one thread; this is for transposing matrices of any
+ * size on the host. A pool of threads is created once and reused: each
+ * call splits A into bands of rows, which the calling thread and the
+ * workers take in order from a shared counter until none are left.
+ */
+#ifndef TRANSPAR_H
+#define TRANSPAR_H
+
+typedef struct trans_pool trans_pool_t;
+
+/*
+ * trans_pool_create - Start a pool that transposes with the given number
+ *     of threads, counting the caller; returns NULL on failure
+ */
+trans_pool_t *trans_pool_create(int threads);
+
+/*
+ * trans_pool_run - Transpose the N x M matrix A into B with the pool's
+ *     threads; returns when B is complete
+ */
+void trans_pool_run(trans_pool_t *pool, int M, int N, int A[N][M], int B[M][N]);
+
+/*
+ * trans_pool_destroy - Stop the workers and free the pool
+ */
+void trans_pool_destroy(trans_pool_t *pool);
+
+#endif /* TRANSPAR_H */
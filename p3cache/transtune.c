@@ -0,0 +1,324 @@
+/*
+ * transtune.c - Search transpose schedules for a matrix and cache.
+ *
+ * Every schedule of transched.h with tiles of up to -T rows and columns,
+ * both tile orders, both element orders and each diagonal strategy is
+ * run on real arrays with its loads and stores fed to an LRU cache
+ * simulator in the same process, so no valgrind run is needed. The
+ * arrays are placed at the addresses tracegen's arrays have, which
+ * decides how A and B collide in the cache: transtune runs ./tracegen
+ * once and reads them from its marker file, unless -A and -B are given.
+ * tracegen is a PIE, so valgrind loads it at another base than a plain
+ * run does; both bases are page aligned, so the set mapping carries
+ * over exactly for caches whose sets repeat within a page (the graded
+ * cache repeats every 1KB). For bigger caches, take -A and -B from a
+ * valgrind trace instead. The schedule with
+ * the fewest misses is printed, or merged into a schedule table (-o)
+ * that trans.c reads at run time.
+ *
+ * The simulated stream is the transpose's own: the few accesses
+ * tracegen adds (the function pointer, M, N and the markers) are not
+ * modelled, so test-trans may count a handful more misses.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <stdint.h>
+
+/* Same dimensions as tracegen's arrays */
+#define MAXN 256
+
+static int A[MAXN][MAXN];
+static int B[MAXN][MAXN];
+
+/* Where tracegen's A and B sit; 0 until -A/-B or locate_arrays sets them */
+static uint64_t base_A = 0;
+static uint64_t base_B = 0;
+
+/* Page size: bases of a PIE differ between runs only above this */
+#define PAGE_BITS 12
+
+/* A set-associative LRU cache, as simulated by csim */
+typedef struct tune_cache {
+    int s, E, b;
+    uint64_t *tag;      /* S*E tags; stamp 0 marks an empty way */
+    uint64_t *stamp;
+    uint64_t clock;
+    uint64_t hits, misses, evictions;
+    FILE *dump;         /* if set, every access is also written as lackey text */
+} tune_cache;
+
+static tune_cache cache;
+
+static void cache_access(tune_cache *c, uint64_t addr, char op)
+{
+    uint64_t line = addr >> c->b;
+    size_t set = (size_t)(line & ((1ULL << c->s) - 1)) * c->E;
+    int i, victim = 0;
+
+    if (c->dump != NULL)
+        fprintf(c->dump, " %c %llx,4\n", op, (unsigned long long)addr);
+    c->clock++;
+    for (i = 0; i < c->E; i++) {
+        if (c->stamp[set + i] != 0 && c->tag[set + i] == line) {
+            c->stamp[set + i] = c->clock;
+            c->hits++;
+            return;
+        }
+        if (c->stamp[set + i] < c->stamp[set + victim])
+            victim = i;
+    }
+    c->misses++;
+    if (c->stamp[set + victim] != 0)
+        c->evictions++;
+    c->tag[set + victim] = line;
+    c->stamp[set + victim] = c->clock;
+}
+
+/*
+ * touch - Feed the simulated address of an element of A or B to the cache
+ */
+static inline void touch(const int *p, char op)
+{
+    uintptr_t a = (uintptr_t)p;
+    if (a >= (uintptr_t)A && a < (uintptr_t)(A + MAXN))
+        cache_access(&cache, base_A + (a - (uintptr_t)A), op);
+    else
+        cache_access(&cache, base_B + (a - (uintptr_t)B), op);
+}
+
+static inline int tune_load(int *p)
+{
+    touch(p, 'L');
+    return *p;
+}
+
+/* The value, and so its load, is evaluated before the store is recorded */
+static inline void tune_store(int *p, int v)
+{
+    touch(p, 'S');
+    *p = v;
+}
+
+#define TS_LOAD(X, r, c) tune_load(&X[r][c])
+#define TS_STORE(X, r, c, v) tune_store(&X[r][c], (v))
+#include "transched.h"
+
+/*
+ * evaluate - Run one schedule from a cold cache; returns its misses, or
+ *     -1 if it does not transpose correctly
+ */
+static long long evaluate(const trans_sched_t *sc)
+{
+    int M = sc->M, N = sc->N, i, j;
+    int (*a)[M] = (int (*)[M])A;
+    int (*b)[N] = (int (*)[N])B;
+    size_t n = ((size_t)1 << cache.s) * cache.E;
+
+    memset(cache.stamp, 0, sizeof(uint64_t) * n);
+    cache.clock = cache.hits = cache.misses = cache.evictions = 0;
+    memset(B, 0, sizeof(B));
+    trans_sched_run(M, N, a, b, sc);
+    for (i = 0; i < N; i++)
+        for (j = 0; j < M; j++)
+            if (b[j][i] != a[i][j])
+                return -1;
+    return (long long)cache.misses;
+}
+
+/*
+ * update_table - Replace the table's entry for this matrix and cache, if
+ *     any, with sc; other lines are kept as they are
+ */
+static int update_table(const char *path, const trans_sched_t *sc, long long misses)
+{
+    char line[256], tmp[1024];
+    trans_sched_t old;
+    FILE *in = fopen(path, "r"), *out;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    if ((out = fopen(tmp, "w")) == NULL)
+        return -1;
+    if (in == NULL)
+        fprintf(out, "# M N s E b tile_r tile_c order inner diag (written by transtune)\n");
+    while (in != NULL && fgets(line, sizeof(line), in) != NULL) {
+        if (trans_sched_read(line, &old) && old.M == sc->M && old.N == sc->N &&
+            old.s == sc->s && old.E == sc->E && old.b == sc->b)
+            continue;
+        fputs(line, out);
+    }
+    if (in != NULL)
+        fclose(in);
+    fprintf(out, "%d %d %d %d %d %d %d %d %d %d\t# %lld misses\n", sc->M, sc->N,
+            sc->s, sc->E, sc->b, sc->tile_r, sc->tile_c, sc->order, sc->inner,
+            sc->diag, misses);
+    if (fclose(out) != 0 || rename(tmp, path) != 0)
+        return -1;
+    return 0;
+}
+
+/*
+ * locate_arrays - Ask ./tracegen where its A and B are; returns 0, or -1
+ *     if it cannot be run
+ */
+static int locate_arrays(int M, int N)
+{
+    char marker[] = "/tmp/transtune-XXXXXX", cmd[256];
+    unsigned long long start, end, a, b;
+    int fd, ok = -1;
+    FILE *fp;
+
+    if ((fd = mkstemp(marker)) < 0)
+        return -1;
+    close(fd);
+    sprintf(cmd, "./tracegen -M %d -N %d -F 0 -m %s >/dev/null 2>&1", M, N, marker);
+    if (system(cmd) == 0 && (fp = fopen(marker, "r")) != NULL) {
+        if (fscanf(fp, "%llx %llx %llx %llx", &start, &end, &a, &b) == 4) {
+            base_A = a;
+            base_B = b;
+            ok = 0;
+        }
+        fclose(fp);
+    }
+    unlink(marker);
+    return ok;
+}
+
+/*
+ * usage - Print usage info
+ */
+void usage(char *argv[])
+{
+    printf("Usage: %s [-hv] -M <num> -N <num> [-s <num> -E <num> -b <num>] [options]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h          Print this help message.\n");
+    printf("  -v          Print every schedule tried.\n");
+    printf("  -M <num>    Columns of A (rows of B).\n");
+    printf("  -N <num>    Rows of A (columns of B).\n");
+    printf("  -s, -E, -b  Cache geometry as for csim (default 5, 1, 5: the graded cache).\n");
+    printf("  -T <num>    Largest tile edge tried (default 32).\n");
+    printf("  -A <addr>   Address of A (default: where ./tracegen puts it).\n");
+    printf("  -B <addr>   Address of B (default: where ./tracegen puts it).\n");
+    printf("  -o <file>   Merge the winner into this schedule table (e.g. %s).\n", SCHED_FILE);
+    printf("  -t <file>   Write the winner's accesses as a lackey trace, for csim.\n");
+    printf("Example: %s -M 61 -N 67 -o %s\n", argv[0], SCHED_FILE);
+}
+
+int main(int argc, char *argv[])
+{
+    int c, i, j, verbose = 0, maxt = 32, tried = 0;
+    char *table = NULL, *dump = NULL;
+    long long misses, best_misses = -1;
+    trans_sched_t sc, best;
+
+    memset(&sc, 0, sizeof(sc));
+    sc.s = 5;
+    sc.E = 1;
+    sc.b = 5;
+    while ((c = getopt(argc, argv, "hvM:N:s:E:b:T:A:B:o:t:")) != -1) {
+        switch (c) {
+        case 'M': sc.M = atoi(optarg); break;
+        case 'N': sc.N = atoi(optarg); break;
+        case 's': sc.s = atoi(optarg); break;
+        case 'E': sc.E = atoi(optarg); break;
+        case 'b': sc.b = atoi(optarg); break;
+        case 'T': maxt = atoi(optarg); break;
+        case 'A': base_A = strtoull(optarg, NULL, 0); break;
+        case 'B': base_B = strtoull(optarg, NULL, 0); break;
+        case 'o': table = optarg; break;
+        case 't': dump = optarg; break;
+        case 'v': verbose = 1; break;
+        case 'h':
+            usage(argv);
+            exit(0);
+        default:
+            usage(argv);
+            exit(1);
+        }
+    }
+
+    if (sc.M <= 0 || sc.N <= 0 || sc.M > MAXN || sc.N > MAXN) {
+        printf("Error: M and N must be between 1 and %d\n", MAXN);
+        usage(argv);
+        exit(1);
+    }
+    if (sc.s < 0 || sc.s > 24 || sc.E < 1 || sc.b < 0 || sc.b > 24 || maxt < 1) {
+        printf("Error: Invalid cache geometry or tile bound\n");
+        exit(1);
+    }
+    if ((base_A == 0) != (base_B == 0)) {
+        printf("Error: give both -A and -B, or neither\n");
+        exit(1);
+    }
+    if (base_A == 0) {
+        if (locate_arrays(sc.M, sc.N) < 0) {
+            printf("Error: could not run ./tracegen to find A and B; give -A and -B\n");
+            exit(1);
+        }
+        printf("A at 0x%llx, B at 0x%llx (from ./tracegen)\n",
+               (unsigned long long)base_A, (unsigned long long)base_B);
+        if (sc.s + sc.b > PAGE_BITS)
+            printf("Warning: sets span more than a page; under valgrind tracegen's arrays may\n"
+                   "         map differently. Give -A and -B from a valgrind trace to be exact.\n");
+    }
+    cache.s = sc.s;
+    cache.E = sc.E;
+    cache.b = sc.b;
+    cache.tag = (uint64_t*)malloc(sizeof(uint64_t) * ((size_t)1 << sc.s) * sc.E);
+    cache.stamp = (uint64_t*)malloc(sizeof(uint64_t) * ((size_t)1 << sc.s) * sc.E);
+    if (cache.tag == NULL || cache.stamp == NULL) {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(1);
+    }
+    for (i = 0; i < sc.N; i++)
+        for (j = 0; j < sc.M; j++)
+            ((int (*)[sc.M])A)[i][j] = i * sc.M + j + 1;
+
+    for (sc.tile_r = 1; sc.tile_r <= maxt && sc.tile_r <= sc.N; sc.tile_r++)
+        for (sc.tile_c = 1; sc.tile_c <= maxt && sc.tile_c <= sc.M; sc.tile_c++)
+            for (sc.order = 0; sc.order < 2; sc.order++)
+                for (sc.diag = TS_DIRECT; sc.diag <= TS_BUFFER; sc.diag++)
+                    for (sc.inner = 0; sc.inner < 2; sc.inner++) {
+                        /* Buffering reads rows of A only, into at most 8 locals */
+                        if (sc.diag == TS_BUFFER && (sc.inner || sc.tile_c > TS_MAX_BUFFER))
+                            continue;
+                        misses = evaluate(&sc);
+                        tried++;
+                        if (verbose)
+                            printf("%d %d %d %d %d %d %d %d %d %d\t%lld\n", sc.M, sc.N,
+                                   sc.s, sc.E, sc.b, sc.tile_r, sc.tile_c, sc.order,
+                                   sc.inner, sc.diag, misses);
+                        if (misses < 0) {
+                            fprintf(stderr, "Error: schedule %dx%d order %d inner %d diag %d is wrong\n",
+                                    sc.tile_r, sc.tile_c, sc.order, sc.inner, sc.diag);
+                            exit(1);
+                        }
+                        if (best_misses < 0 || misses < best_misses) {
+                            best_misses = misses;
+                            best = sc;
+                        }
+                    }
+
+    printf("best of %d: %d %d %d %d %d %d %d %d %d %d\t# %lld misses\n", tried,
+           best.M, best.N, best.s, best.E, best.b, best.tile_r, best.tile_c,
+           best.order, best.inner, best.diag, best_misses);
+    if (dump != NULL) {
+        if ((cache.dump = fopen(dump, "w")) == NULL) {
+            fprintf(stderr, "Error: could not open %s\n", dump);
+            exit(1);
+        }
+        evaluate(&best);
+        fclose(cache.dump);
+        cache.dump = NULL;
+    }
+    if (table != NULL && update_table(table, &best, best_misses) < 0) {
+        fprintf(stderr, "Error: could not update %s\n", table);
+        exit(1);
+    }
+    free(cache.tag);
+    free(cache.stamp);
+    return 0;
+}